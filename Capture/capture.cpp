@@ -1,19 +1,30 @@
 
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <memory>
 #include <unistd.h>
-#include <redis-cpp/stream.h>
-#include <redis-cpp/execute.h>
 #include "cmdline.h"
 #include "parser.hpp"
+#include "safe-queue.hpp"
+#include "double-buffer-queue.hpp"
+#include "redis-sink.hpp"
+#include "file-sink.hpp"
+#include "shm-sink.hpp"
+#include "recorder-sink.hpp"
+#include "audio-sink.hpp"
+#include "adaptive-batcher.hpp"
+#include "histogram.hpp"
 
 using std::cout;
 using std::endl;
 using std::string;
 using namespace Tins;
 
-static void redis_execute_xadd_no_flush(std::shared_ptr<std::iostream> stream_p, std::string key, std::shared_ptr<Parser::datagram_t> value_p);
-
 int main(int argc, char *argv[])
 {
     // setup cmdline parser
@@ -27,15 +38,77 @@ int main(int argc, char *argv[])
     cmdline_parser.add<string>("pcap-immediate-mode", '\0', "immediate mode", false, "false", cmdline::oneof<string>("true", "false"));
     cmdline_parser.add("pcap-from-file", '\0', "use pcap file instead of interface");
 
+    cmdline_parser.add<string>("queue-strategy", '\0', "queue between sniffer and writer. safe-queue or double-buffer", false, "safe-queue", cmdline::oneof<string>("safe-queue", "double-buffer"));
+    cmdline_parser.add<int>("queue-publish-threshold", '\0', "double-buffer: datagrams batched by the sniffer before publishing", false, 256, cmdline::range(1, 1000000));
+    cmdline_parser.add<int>("queue-flush-interval", '\0', "double-buffer: live capture publishes datagrams held back by the sniffer this often [ms]", false, 1, cmdline::range(1, 1000));
+
     cmdline_parser.add<string>("redis-hostname", '\0', "redis-server hostname", false, "127.0.0.1");
     cmdline_parser.add<string>("redis-port", '\0', "redis-server port number", false, "6379");
     cmdline_parser.add<string>("redis-database-number", '\0', "redis-server port number", false, "0");
 
-    cmdline_parser.add<string>("divide-streams", '\0', "divide stream type", false, "ip", cmdline::oneof<string>("none", "mac", "ip"));
+    cmdline_parser.add<string>("divide-streams", '\0', "divide stream type. none, mac, ip or call (per SIP Call-ID, implies --sip)", false, "ip", cmdline::oneof<string>("none", "mac", "ip", "call"));
     cmdline_parser.add<int>("stream-max-length", '\0', "stream max length", false, 10000, cmdline::range(0, std::numeric_limits<int>::max()));
     cmdline_parser.add<string>("stream-prefix", '\0', "stream prefix", false, "stream/");
     cmdline_parser.add<string>("default-stream", '\0', "default stream name", false, "default");
+    cmdline_parser.add<string>("sinks", '\0', "where datagrams are stored, comma separated. redis, file, shm, recorder, audio", false, "redis");
+    cmdline_parser.add<string>("file-sink-path", '\0', "file sink: path prefix, files are <prefix>-<sequence>.bsn", false, "capture");
+    cmdline_parser.add<int>("file-sink-max-size", '\0', "file sink: rotate after [MB]", false, 256, cmdline::range(1, 1024 * 1024));
+    cmdline_parser.add<int>("file-sink-max-files", '\0', "file sink: delete the oldest files beyond this, 0 keeps all", false, 0, cmdline::range(0, std::numeric_limits<int>::max()));
+    cmdline_parser.add<string>("shm-sink-name", '\0', "shm sink: POSIX shared memory name of the ring, kept after exit for the next run and its readers", false, "/basin-capture");
+    cmdline_parser.add<int>("shm-sink-size", '\0', "shm sink: ring size [MB]", false, 64, cmdline::range(1, 64 * 1024));
+    cmdline_parser.add<string>("recorder-path", '\0', "recorder sink: directory of the WAV files of G.711 RTP streams", false, "recordings");
+    cmdline_parser.add<int>("recorder-jitter-packets", '\0', "recorder sink: packets held back to reorder a stream", false, 8, cmdline::range(1, 1024));
+    cmdline_parser.add<int>("recorder-idle-timeout", '\0', "recorder sink: finish streams idle for this long [s]", false, 10, cmdline::range(1, 86400));
+    cmdline_parser.add<int>("recorder-max-streams", '\0', "recorder sink: streams recorded at the same time per writer", false, 1024, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add("recorder-direct-io", '\0', "recorder sink: write WAV files with O_DIRECT, bypassing the page cache");
+    cmdline_parser.add<string>("recorder-stream", '\0', "recorder sink: stream name of finished recordings", false, "recordings");
+    cmdline_parser.add<int>("audio-frame-ms", '\0', "audio sink: decoded G.711 RTP is added in frames of [ms]", false, 160, cmdline::range(20, 1000));
+    cmdline_parser.add<int>("audio-jitter-packets", '\0', "audio sink: packets held back to reorder a stream", false, 4, cmdline::range(1, 1024));
+    cmdline_parser.add<int>("audio-idle-timeout", '\0', "audio sink: end streams idle for this long [s]", false, 5, cmdline::range(1, 86400));
+    cmdline_parser.add<int>("audio-max-streams", '\0', "audio sink: streams decoded at the same time per writer", false, 1024, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<string>("audio-stream", '\0', "audio sink: stream name of the PCM frames", false, "audio");
+    cmdline_parser.add<string>("redis-unix-socket", '\0', "connect to redis through this unix domain socket instead of redis-hostname and redis-port", false, "");
+    cmdline_parser.add<int>("redis-socket-buffer-size", '\0', "send and receive buffer of the redis connection [KB], 0 for the system default", false, 0, cmdline::range(0, 1024 * 1024));
+    cmdline_parser.add("redis-cluster", '\0', "redis-hostname and redis-port name a seed node of a redis cluster, database number is ignored");
+    cmdline_parser.add<int>("redis-writers", '\0', "writer threads, each with its own connection. streams are divided among them by key", false, 1, cmdline::range(1, 256));
+    cmdline_parser.add<int>("writer-target-latency", '\0', "enqueue-to-ack latency the writer sizes its batches for [ms]", false, 10, cmdline::range(1, 10000));
+    cmdline_parser.add<int>("writer-min-batch", '\0', "smallest batch the writer sends when datagrams are waiting", false, 16, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("writer-max-batch", '\0', "largest batch the writer sends at once", false, 65536, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("writer-stats-interval", '\0', "print batch sizes and enqueue-to-ack latency every [s], 0 to disable", false, 10, cmdline::range(0, 86400));
+    cmdline_parser.add("ip-defragment", '\0', "reassemble IPv4 and IPv6 fragments before parsing layer 4");
+    cmdline_parser.add<int>("ip-defragment-max-datagrams", '\0', "incomplete fragmented datagrams kept at the same time", false, 4096, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("ip-defragment-timeout", '\0', "drop incomplete fragmented datagrams after [s]", false, 30, cmdline::range(1, 3600));
+    cmdline_parser.add("decapsulate", '\0', "record VLAN ids, MPLS labels and IP-in-IP, GRE or VXLAN tunnels of each packet");
+    cmdline_parser.add("decapsulate-route-inner", '\0', "fill addresses, ports and payload from the innermost tunneled packet");
+    cmdline_parser.add<int>("vxlan-port", '\0', "UDP port of VXLAN tunnels", false, 4789, cmdline::range(1, 65535));
+    cmdline_parser.add("tcp-reassembly", '\0', "reassemble TCP streams, emit in-order payload instead of segments");
+    cmdline_parser.add<int>("tcp-reassembly-max-streams", '\0', "TCP streams reassembled at the same time", false, 65536, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("tcp-reassembly-max-buffered", '\0', "out of order data a reassembled TCP stream may hold before it passes through [KB]", false, 3072, cmdline::range(1, 1024 * 1024));
+    cmdline_parser.add<int>("tcp-reassembly-idle-timeout", '\0', "drop reassembled TCP streams idle for this long [s]", false, 60, cmdline::range(1, 86400));
+
+    cmdline_parser.add("flows", '\0', "aggregate packets into flow records instead of storing every packet");
+    cmdline_parser.add<int>("flow-max", '\0', "flows tracked at the same time", false, 65536, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("flow-idle-timeout", '\0', "export flows idle for this long [s]", false, 15, cmdline::range(1, 86400));
+    cmdline_parser.add<int>("flow-active-timeout", '\0', "export long running flows at this interval [s]", false, 60, cmdline::range(1, 86400));
+    cmdline_parser.add<string>("flow-packet-ports", '\0', "still store packets from or to these ports one by one, comma separated", false, "");
+    cmdline_parser.add<string>("flow-stream", '\0', "stream name of flow records", false, "flows");
+
+    cmdline_parser.add("sip", '\0', "follow SIP calls, mark signalling and negotiated RTP/RTCP with their Call-ID");
+    cmdline_parser.add<string>("sip-ports", '\0', "UDP and TCP ports carrying SIP, comma separated", false, "5060");
+    cmdline_parser.add<int>("sip-max-endpoints", '\0', "media endpoints followed at the same time", false, 65536, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("sip-media-timeout", '\0', "forget media endpoints idle for this long [s]", false, 60, cmdline::range(1, 86400));
+
+    cmdline_parser.add<int>("sample-packets", '\0', "store 1 in N packets", false, 1, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<int>("sample-flows", '\0', "store all packets of 1 in N flows, chosen by flow hash", false, 1, cmdline::range(1, std::numeric_limits<int>::max()));
+    cmdline_parser.add<double>("sample-rate-limit", '\0', "store at most this many packets per second per destination stream, 0 for no limit", false, 0);
+    cmdline_parser.add<double>("sample-rate-burst", '\0', "packets stored at once above the rate limit, the limit if 0", false, 0);
+
+    cmdline_parser.add<string>("record-format", '\0', "stream entry format. fields or packed", false, "fields", cmdline::oneof<string>("fields", "packed"));
     cmdline_parser.add<string>("payload-convert-method", '\0', "peyload convert method. base64 or hex", false, "base64", cmdline::oneof<string>("base64", "hex"));
+    cmdline_parser.add<string>("payload-compression", '\0', "payload compression. none, lz4 or zstd", false, "none", cmdline::oneof<string>("none", "lz4", "zstd"));
+    cmdline_parser.add<string>("payload-compression-ports", '\0', "compress only payloads from or to these ports, comma separated. all if empty, required with the recorder and audio sinks", false, "");
+    cmdline_parser.add<string>("payload-compression-dictionary", '\0', "pre-trained compression dictionary file", false, "");
+    cmdline_parser.add<int>("payload-compression-level", '\0', "zstd level or lz4 acceleration, 0 for default", false, 0, cmdline::range(0, 22));
 
     // print usage and exit, if mandatory args not set.
     cmdline_parser.parse_check(argc, argv);
@@ -55,23 +128,108 @@ int main(int argc, char *argv[])
     //redis_config.port = cmdline_parser.get<string>("redis-port");
     //Redis redis(redis_config);
 
-    static SafeQueue<Parser::datagram_t> safe_queue;
+    // one queue per writer
+    const int redis_writers = cmdline_parser.get<int>("redis-writers");
+    std::vector<std::unique_ptr<BatchQueue<Parser::datagram_t>>> queues;
+    std::vector<BatchQueue<Parser::datagram_t> *> queue_ptrs;
+    for (int i = 0; i < redis_writers; i++)
+    {
+        if (cmdline_parser.get<string>("queue-strategy") == "double-buffer")
+        {
+            queues.emplace_back(new DoubleBufferQueue<Parser::datagram_t>(cmdline_parser.get<int>("queue-publish-threshold")));
+        }
+        else
+        {
+            queues.emplace_back(new SafeQueue<Parser::datagram_t>());
+        }
+        queue_ptrs.push_back(queues.back().get());
+    }
+
+    SafeQueue<FlowTable::record_t> flow_queue;
 
     // create parser instance
     Parser::config_t parser_config;
+    std::vector<string> sink_names;
+    {
+        std::stringstream ss(cmdline_parser.get<string>("sinks"));
+        string name;
+        while (std::getline(ss, name, ','))
+        {
+            sink_names.push_back(name);
+        }
+    }
+    // file and shm sinks store packed records and the recorder and audio
+    // sinks read the raw payload from them, whatever the record format
+    const bool sinks_need_record = std::find_if(sink_names.begin(), sink_names.end(), [](const string &name) {
+                                       return name == "file" || name == "shm" || name == "recorder" || name == "audio";
+                                   }) != sink_names.end();
+
     parser_config.payload_convert_method = cmdline_parser.get<string>("payload-convert-method");
+    parser_config.record_format = cmdline_parser.get<string>("record-format");
+    parser_config.build_record = sinks_need_record;
+    parser_config.ip_defragment.enabled = cmdline_parser.exist("ip-defragment");
+    parser_config.ip_defragment.max_datagrams = cmdline_parser.get<int>("ip-defragment-max-datagrams");
+    parser_config.ip_defragment.timeout_sec = cmdline_parser.get<int>("ip-defragment-timeout");
+    parser_config.decapsulation.enabled = cmdline_parser.exist("decapsulate") || cmdline_parser.exist("decapsulate-route-inner");
+    parser_config.decapsulation.route_inner = cmdline_parser.exist("decapsulate-route-inner");
+    parser_config.decapsulation.vxlan_port = cmdline_parser.get<int>("vxlan-port");
+    parser_config.tcp_reassembly.enabled = cmdline_parser.exist("tcp-reassembly");
+    parser_config.tcp_reassembly.max_streams = cmdline_parser.get<int>("tcp-reassembly-max-streams");
+    parser_config.tcp_reassembly.max_buffered_bytes = (size_t)cmdline_parser.get<int>("tcp-reassembly-max-buffered") * 1024;
+    parser_config.tcp_reassembly.idle_timeout_sec = cmdline_parser.get<int>("tcp-reassembly-idle-timeout");
+    parser_config.compression.method = cmdline_parser.get<string>("payload-compression");
+    parser_config.compression.dictionary_path = cmdline_parser.get<string>("payload-compression-dictionary");
+    parser_config.compression.level = cmdline_parser.get<int>("payload-compression-level");
+    parser_config.sampling.packet_rate = cmdline_parser.get<int>("sample-packets");
+    parser_config.sampling.flow_rate = cmdline_parser.get<int>("sample-flows");
+    parser_config.sampling.rate_limit = cmdline_parser.get<double>("sample-rate-limit");
+    parser_config.sampling.rate_burst = cmdline_parser.get<double>("sample-rate-burst");
+    parser_config.sampling.divide_streams = cmdline_parser.get<string>("divide-streams");
+    parser_config.flows.enabled = cmdline_parser.exist("flows");
+    parser_config.flows.max_flows = cmdline_parser.get<int>("flow-max");
+    parser_config.flows.idle_timeout_sec = cmdline_parser.get<int>("flow-idle-timeout");
+    parser_config.flows.active_timeout_sec = cmdline_parser.get<int>("flow-active-timeout");
+    parser_config.sip.enabled = cmdline_parser.exist("sip");
+    parser_config.sip.max_endpoints = cmdline_parser.get<int>("sip-max-endpoints");
+    parser_config.sip.media_timeout_sec = cmdline_parser.get<int>("sip-media-timeout");
 
-    //parser_config.divide_stream = cmdline_parser.get<string>("divide-streams");
-    //parser_config.stream_prefix = cmdline_parser.get<string>("stream-prefix");
-    //parser_config.default_stream = cmdline_parser.get<string>("default-stream");
+    parser_config.divide_streams = cmdline_parser.get<string>("divide-streams");
+    parser_config.stream_prefix = cmdline_parser.get<string>("stream-prefix");
+    parser_config.default_stream = cmdline_parser.get<string>("default-stream");
 
-    Parser parser(parser_config, &safe_queue);
+    std::unique_ptr<Parser> parser;
+    try
+    {
+        parser_config.compression.ports = PayloadCompressor::parse_ports(cmdline_parser.get<string>("payload-compression-ports"));
+        parser_config.flows.packet_ports = PayloadCompressor::parse_ports(cmdline_parser.get<string>("flow-packet-ports"));
+        parser_config.sip.ports = PayloadCompressor::parse_ports(cmdline_parser.get<string>("sip-ports"));
+        // RTP ports are negotiated, compressing every port would hide all
+        // RTP from the recorder and audio sinks, which skip compressed payloads
+        const bool sinks_need_rtp = std::find_if(sink_names.begin(), sink_names.end(), [](const string &name) {
+                                        return name == "recorder" || name == "audio";
+                                    }) != sink_names.end();
+        if (sinks_need_rtp && parser_config.compression.method != "none" && parser_config.compression.ports.empty())
+        {
+            throw std::runtime_error("the recorder and audio sinks need uncompressed RTP, limit --payload-compression with --payload-compression-ports");
+        }
+        parser.reset(new Parser(parser_config, queue_ptrs, &flow_queue));
+    }
+    catch (std::exception &e)
+    {
+        std::cout << "error: " << e.what() << std::endl;
+        return -1;
+    }
 
     std::thread t1([&] {
         if (cmdline_parser.exist("pcap-from-file"))
         {
             FileSniffer sniffer(cmdline_parser.get<string>("pcap-interface"), sniffer_config);
-            sniffer.sniff_loop(parser.parse);
+            sniffer.sniff_loop(Parser::parse);
+            parser->flush();
+            for (auto &queue : queues)
+            {
+                queue->flush();
+            }
         }
         else
         {
@@ -80,8 +238,58 @@ int main(int argc, char *argv[])
             {
                 // create sniffer instance
                 Sniffer sniffer(cmdline_parser.get<string>("pcap-interface"), sniffer_config);
-                // start sniffer
-                sniffer.sniff_loop(parser.parse);
+                const bool expire_flows = parser_config.flows.enabled;
+                const bool flush_queues = cmdline_parser.get<string>("queue-strategy") == "double-buffer";
+                if (!expire_flows && !flush_queues)
+                {
+                    // start sniffer
+                    sniffer.sniff_loop(Parser::parse);
+                }
+                else
+                {
+                    // the loop only returns for a packet, so a ticker breaks it: to
+                    // publish datagrams the double buffer queues hold back on the
+                    // sniffer side, and once a second so flows of a quiet link
+                    // expire in this thread. a return nobody asked for ends the capture.
+                    const std::chrono::milliseconds tick(flush_queues ? cmdline_parser.get<int>("queue-flush-interval") : 1000);
+                    const uint64_t expire_interval_usec = 1000000;
+                    std::atomic<uint64_t> breaks_requested{0};
+                    std::atomic<bool> sniffing{true};
+                    std::thread ticker([&] {
+                        while (sniffing.load())
+                        {
+                            std::this_thread::sleep_for(tick);
+                            breaks_requested++;
+                            sniffer.stop_sniff();
+                        }
+                    });
+                    uint64_t breaks_handled = 0;
+                    uint64_t next_expire_usec = 0;
+                    while (true)
+                    {
+                        sniffer.sniff_loop(Parser::parse);
+                        if (breaks_handled == breaks_requested.load())
+                        {
+                            break;
+                        }
+                        breaks_handled++;
+                        if (flush_queues)
+                        {
+                            for (auto &queue : queues)
+                            {
+                                queue->flush();
+                            }
+                        }
+                        const uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                        if (expire_flows && now >= next_expire_usec)
+                        {
+                            parser->expire(now);
+                            next_expire_usec = now + expire_interval_usec;
+                        }
+                    }
+                    sniffing.store(false);
+                    ticker.join();
+                }
             }
             catch (Tins::pcap_error pe)
             {
@@ -91,128 +299,203 @@ int main(int argc, char *argv[])
         }
     });
 
-    std::thread t2([&] {
-        while (true)
+    AdaptiveBatcher::config_t batcher_config;
+    batcher_config.target_latency_usec = (uint64_t)cmdline_parser.get<int>("writer-target-latency") * 1000;
+    batcher_config.min_batch = cmdline_parser.get<int>("writer-min-batch");
+    batcher_config.max_batch = cmdline_parser.get<int>("writer-max-batch");
+
+    RedisSink::config_t redis_sink_config;
+    redis_sink_config.hostname = cmdline_parser.get<string>("redis-hostname");
+    redis_sink_config.port = cmdline_parser.get<string>("redis-port");
+    redis_sink_config.unix_socket = cmdline_parser.get<string>("redis-unix-socket");
+    redis_sink_config.socket_buffer_size = cmdline_parser.get<int>("redis-socket-buffer-size") * 1024;
+    redis_sink_config.database_number = cmdline_parser.get<string>("redis-database-number");
+    redis_sink_config.cluster = cmdline_parser.exist("redis-cluster");
+    redis_sink_config.packed = cmdline_parser.get<string>("record-format") == "packed";
+    redis_sink_config.stream_max_length = cmdline_parser.get<int>("stream-max-length");
+    redis_sink_config.flow_stream_key = cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("flow-stream");
+
+    // each writer owns a queue and its sinks. with several writers, file and
+    // shm names get the writer index appended. writer 0 also stores flow
+    // records and reports sampling.
+    std::vector<std::vector<std::unique_ptr<Sink>>> writer_sinks(redis_writers);
+    try
+    {
+        for (int i = 0; i < redis_writers; i++)
         {
-            if (safe_queue.size() > 0)
+            const string suffix = redis_writers > 1 ? "-" + std::to_string(i) : "";
+            for (const string &name : sink_names)
             {
-                auto stream = rediscpp::make_stream(cmdline_parser.get<string>("redis-hostname"),
-                                                    cmdline_parser.get<string>("redis-port"));
+                if (name == "redis")
+                {
+                    writer_sinks[i].emplace_back(new RedisSink(redis_sink_config));
+                }
+                else if (name == "file")
+                {
+                    FileSink::config_t file_sink_config;
+                    file_sink_config.path = cmdline_parser.get<string>("file-sink-path") + suffix;
+                    file_sink_config.max_file_size = (size_t)cmdline_parser.get<int>("file-sink-max-size") * 1024 * 1024;
+                    file_sink_config.max_files = cmdline_parser.get<int>("file-sink-max-files");
+                    writer_sinks[i].emplace_back(new FileSink(file_sink_config));
+                }
+                else if (name == "shm")
+                {
+                    ShmSink::config_t shm_sink_config;
+                    shm_sink_config.name = cmdline_parser.get<string>("shm-sink-name") + suffix;
+                    shm_sink_config.size = (size_t)cmdline_parser.get<int>("shm-sink-size") * 1024 * 1024;
+                    writer_sinks[i].emplace_back(new ShmSink(shm_sink_config));
+                }
+                else if (name == "recorder")
+                {
+                    // every writer records the streams routed to it into the same directory
+                    RecorderSink::config_t recorder_sink_config;
+                    recorder_sink_config.path = cmdline_parser.get<string>("recorder-path");
+                    recorder_sink_config.jitter_packets = cmdline_parser.get<int>("recorder-jitter-packets");
+                    recorder_sink_config.idle_timeout_sec = cmdline_parser.get<int>("recorder-idle-timeout");
+                    recorder_sink_config.max_streams = cmdline_parser.get<int>("recorder-max-streams");
+                    recorder_sink_config.file.direct = cmdline_parser.exist("recorder-direct-io");
+                    recorder_sink_config.redis = redis_sink_config;
+                    recorder_sink_config.stream_key = cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("recorder-stream");
+                    writer_sinks[i].emplace_back(new RecorderSink(recorder_sink_config));
+                }
+                else if (name == "audio")
+                {
+                    AudioSink::config_t audio_sink_config;
+                    audio_sink_config.frame_ms = cmdline_parser.get<int>("audio-frame-ms");
+                    audio_sink_config.jitter_packets = cmdline_parser.get<int>("audio-jitter-packets");
+                    audio_sink_config.idle_timeout_sec = cmdline_parser.get<int>("audio-idle-timeout");
+                    audio_sink_config.max_streams = cmdline_parser.get<int>("audio-max-streams");
+                    audio_sink_config.redis = redis_sink_config;
+                    audio_sink_config.stream_key = cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("audio-stream");
+                    writer_sinks[i].emplace_back(new AudioSink(audio_sink_config));
+                }
+                else
+                {
+                    throw std::invalid_argument("unknown sink: " + name);
+                }
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cout << "error: " << e.what() << std::endl;
+        exit(-1);
+    }
 
-                rediscpp::execute_no_flush(*stream, "SELECT", cmdline_parser.get<string>("redis-database-number"));
-                size_t cnt = 1;
+    auto writer = [&](int index) {
+        BatchQueue<Parser::datagram_t> *queue = queues[index].get();
+        std::vector<std::unique_ptr<Sink>> &sinks = writer_sinks[index];
 
+        // reused between batches, so steady state does not allocate
+        std::vector<Parser::datagram_t> batch;
+        std::vector<FlowTable::record_t> flow_batch;
+        uint64_t reported_sampled_out = 0;
+        AdaptiveBatcher batcher(batcher_config);
+        Histogram batch_sizes;
+        Histogram latencies;
+        const int writer_stats_interval = cmdline_parser.get<int>("writer-stats-interval");
+        int seconds_since_stats = 0;
+        auto next_report = std::chrono::steady_clock::now();
 
-                while (!safe_queue.empty())
+        // datagrams of `batch` from `next` on are not sent yet
+        size_t next = 0;
+
+        auto now_usec = [] {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        };
+
+        while (true)
+        {
+            if (next == batch.size() && queue->size() > 0)
+            {
+                queue->swap(batch);
+                next = 0;
+            }
+
+            if (next < batch.size() || (index == 0 && flow_queue.size() > 0))
+            {
+                const size_t count = batcher.next_batch_size(batch.size() - next + queue->size(), now_usec());
+                const size_t end = std::min(batch.size(), next + std::max<size_t>(count, 1));
+                if (index == 0)
+                {
+                    flow_queue.swap(flow_batch);
+                }
+
+                const uint64_t sent_usec = now_usec();
+                for (auto &sink : sinks)
                 {
                     try
                     {
-                        auto value = safe_queue.pop();
-
-                        if (cmdline_parser.get<string>("divide-streams") == "mac")
-                        {
-                            if (value->layer_2_src_addr == "" || value->layer_2_dst_addr == "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("default-stream"), value);
-                                cnt++;
-                            }
-                            if (value->layer_2_src_addr != "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + value->layer_2_src_addr, value);
-                                cnt++;
-                            }
-                            if (value->layer_2_dst_addr != "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + value->layer_2_dst_addr, value);
-                                cnt++;
-                            }
-                        }
-                        else if (cmdline_parser.get<string>("divide-streams") == "ip")
-                        {
-                            if (value->layer_3_src_addr == "" || value->layer_3_dst_addr == "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("default-stream"), value);
-                                cnt++;
-                            }
-                            if (value->layer_3_src_addr != "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + value->layer_3_src_addr, value);
-                                cnt++;
-                            }
-                            if (value->layer_3_dst_addr != "")
-                            {
-                                redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + value->layer_3_dst_addr, value);
-                                cnt++;
-                            }
-                        }
-                        else
-                        {
-                            redis_execute_xadd_no_flush(stream, cmdline_parser.get<string>("stream-prefix") + cmdline_parser.get<string>("default-stream"), value);
-                            cnt++;
-                        }
+                        sink->write(batch.data() + next, end - next, flow_batch.data(), flow_batch.size());
                     }
-                    catch (EmptyQueue &e)
+                    catch (std::runtime_error &e)
                     {
-                        continue;
+                        std::cout << sink->name() << " error: " << e.what() << std::endl;
                     }
                 }
-                if (cmdline_parser.get<int>("stream-max-length") > 0)
+                const uint64_t acked_usec = now_usec();
+
+                batcher.record(end - next, acked_usec - sent_usec);
+                batch_sizes.record(end - next);
+                for (size_t i = next; i < end; i++)
                 {
-                    rediscpp::execute_no_flush(*stream, "XTRIM", "test-stream", "MAXLEN", "~", std::to_string(cmdline_parser.get<int>("stream-max-length")));
-                    cnt++;
+                    latencies.record(acked_usec - batch[i].enqueued_usec);
                 }
+                flow_batch.clear();
+                next = end;
+            }
+            else
+            {
+                usleep(batcher.idle_wait_usec());
+            }
 
-                std::flush(*stream);
-
-                for (size_t i = 0; i < cnt; i++)
+            if (std::chrono::steady_clock::now() >= next_report)
+            {
+                for (auto &sink : sinks)
                 {
                     try
                     {
-                        rediscpp::value value{*stream};
-                        if (value.is_error_message())
-                        {
-                            std::cout << "Redis: Error:";
-                            if (value.is_string())
-                            {
-                                std::cout << value.as_string() << std::endl;
-                            }
-                            else
-                            {
-                                std::cout << std::endl;
-                            }
-                        }
+                        sink->poll();
                     }
                     catch (std::runtime_error &e)
                     {
-                        std::cout << "Redis error: " << e.what() << std::endl;
+                        std::cout << sink->name() << " error: " << e.what() << std::endl;
                     }
                 }
+                if (index == 0 && parser->sampled_out() != reported_sampled_out)
+                {
+                    reported_sampled_out = parser->sampled_out();
+                    std::cout << "Sampling: " << reported_sampled_out << " packets sampled out" << std::endl;
+                }
+                if (writer_stats_interval > 0 && ++seconds_since_stats >= writer_stats_interval && batch_sizes.count() > 0)
+                {
+                    std::cout << "Writer " << index << ": " << batch_sizes.count() << " batches, size mean "
+                              << (uint64_t)batch_sizes.mean() << " p50 " << batch_sizes.percentile(50)
+                              << " p99 " << batch_sizes.percentile(99) << " max " << batch_sizes.max()
+                              << ", enqueue-to-ack [us] p50 " << latencies.percentile(50)
+                              << " p99 " << latencies.percentile(99) << " max " << latencies.max()
+                              << ", cost " << batcher.cost_per_datagram_usec() << " us/datagram"
+                              << " + " << (uint64_t)batcher.fixed_cost_usec() << " us/pipeline" << std::endl;
+                    batch_sizes.reset();
+                    latencies.reset();
+                    seconds_since_stats = 0;
+                }
+                next_report += std::chrono::seconds(1);
             }
-
-            usleep(5000);
         }
-    });
+    };
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < redis_writers; i++)
+    {
+        writers.emplace_back(writer, i);
+    }
 
     t1.join();
-    t2.join();
+    for (auto &t : writers)
+    {
+        t.join();
+    }
 
     return 0;
 }
-
-static void redis_execute_xadd_no_flush(std::shared_ptr<std::iostream> stream_p, std::string key, std::shared_ptr<Parser::datagram_t> value_p)
-{
-    rediscpp::execute_no_flush(*stream_p, "XADD", key, "*",
-                               "layer_2_type", value_p->layer_2_type,
-                               "layer_2_src_addr", value_p->layer_2_src_addr,
-                               "layer_2_dst_addr", value_p->layer_2_dst_addr,
-                               "layer_3_type", value_p->layer_3_type,
-                               "layer_3_src_addr", value_p->layer_3_src_addr,
-                               "layer_3_dst_addr", value_p->layer_3_dst_addr,
-                               "layer_4_type", value_p->layer_4_type,
-                               "layer_4_src_port", value_p->layer_4_src_port,
-                               "layer_4_dst_port", value_p->layer_4_dst_port,
-                               "payload_type", value_p->payload_type,
-                               "payload_size", value_p->payload_size,
-                               "payload_encoding_type", value_p->payload_encoding_type,
-                               "payload_payload", value_p->payload);
-};
@@ -0,0 +1,27 @@
+#ifndef INCLUDE_GUARD_BATCH_QUEUE_HPP
+#define INCLUDE_GUARD_BATCH_QUEUE_HPP
+
+#include <vector>
+#include <cstddef>
+
+// common interface of the queues between the sniffer and the redis writer.
+// the producer pushes one element at a time, the consumer takes everything
+// pending in one swap.
+template <typename T>
+class BatchQueue {
+public:
+    virtual ~BatchQueue() {}
+
+    virtual void push(T&& value) = 0;
+    virtual void swap(std::vector<T>& out) = 0;
+    virtual size_t size() const = 0;
+
+    // called by the producer when it has nothing more to push for now.
+    virtual void flush() {}
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+#endif // INCLUDE_GUARD_BATCH_QUEUE_HPP
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_GUARD_DOUBLE_BUFFER_QUEUE_HPP
+#define INCLUDE_GUARD_DOUBLE_BUFFER_QUEUE_HPP
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include "batch-queue.hpp"
+
+// single producer / single consumer queue without locks.
+// the producer appends to a vector only it touches. once the consumer has
+// taken the previous batch and `publish_threshold` elements are pending, the
+// producer publishes the whole vector with one atomic pointer store, and the
+// consumer takes it with one exchange. emptied vectors go back to the
+// producer the same way, so elements are never copied between buffers.
+//
+// fewer than `publish_threshold` elements, or elements pushed while the
+// consumer is still busy, stay on the producer side until the next push that
+// publishes. an idle producer must call flush() now and then: capture does
+// that from its sniffer loop every --queue-flush-interval.
+template <typename T>
+class DoubleBufferQueue : public BatchQueue<T> {
+public:
+    explicit DoubleBufferQueue(size_t publish_threshold = 256)
+        : _publish_threshold(publish_threshold == 0 ? 1 : publish_threshold),
+          _pending(new std::vector<T>()) {}
+    DoubleBufferQueue(DoubleBufferQueue const&) = delete;
+    DoubleBufferQueue& operator=(DoubleBufferQueue const&) = delete;
+    ~DoubleBufferQueue() {
+        delete _pending;
+        delete _published.load();
+        delete _spare.load();
+    }
+
+    // producer side
+    void push(T&& value) override {
+        _pending->push_back(std::move(value));
+        _pending_size.store(_pending->size(), std::memory_order_relaxed);
+        if(_pending->size() >= _publish_threshold && _published.load(std::memory_order_relaxed) == nullptr) {
+            publish();
+        }
+    }
+
+    // publishes every pending element. if the consumer has not taken the
+    // previous batch yet, they are appended to it.
+    void flush() override {
+        if(_pending->empty()) return;
+        std::vector<T>* published = _published.exchange(nullptr, std::memory_order_acquire);
+        if(published == nullptr) {
+            publish();
+            return;
+        }
+        const size_t n = _pending->size();
+        published->insert(published->end(),
+                          std::make_move_iterator(_pending->begin()),
+                          std::make_move_iterator(_pending->end()));
+        _pending->clear();
+        _published_size.fetch_add(n, std::memory_order_relaxed);
+        _pending_size.store(0, std::memory_order_relaxed);
+        _published.store(published, std::memory_order_release);
+    }
+
+    // consumer side. `out` is cleared and its buffer goes back to the producer.
+    void swap(std::vector<T>& out) override {
+        out.clear();
+        std::vector<T>* published = _published.exchange(nullptr, std::memory_order_acquire);
+        if(published == nullptr) return;
+        out.swap(*published);
+        _published_size.fetch_sub(out.size(), std::memory_order_relaxed);
+        delete _spare.exchange(published, std::memory_order_acq_rel);
+    }
+
+    // published and pending elements
+    size_t size() const override {
+        return _published_size.load(std::memory_order_relaxed) + _pending_size.load(std::memory_order_relaxed);
+    }
+
+private:
+    const size_t _publish_threshold;
+    // owned by the producer
+    std::vector<T>* _pending;
+    // handed to the consumer, nullptr once it took them. only the producer
+    // stores a vector here, so one it finds empty stays empty until then.
+    std::atomic<std::vector<T>*> _published{nullptr};
+    // emptied vector handed back by the consumer
+    std::atomic<std::vector<T>*> _spare{nullptr};
+    std::atomic<size_t> _pending_size{0};
+    std::atomic<size_t> _published_size{0};
+
+    // producer side, with _published empty
+    void publish() {
+        std::vector<T>* published = _pending;
+        _pending = _spare.exchange(nullptr, std::memory_order_acquire);
+        if(_pending == nullptr) _pending = new std::vector<T>();
+        _published_size.fetch_add(published->size(), std::memory_order_relaxed);
+        _pending_size.store(0, std::memory_order_relaxed);
+        _published.store(published, std::memory_order_release);
+    }
+};
+
+#endif // INCLUDE_GUARD_DOUBLE_BUFFER_QUEUE_HPP
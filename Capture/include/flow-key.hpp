@@ -0,0 +1,94 @@
+#ifndef INCLUDE_GUARD_FLOW_KEY_HPP
+#define INCLUDE_GUARD_FLOW_KEY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "packed-record.hpp"
+
+// direction independent 5-tuple of a datagram. endpoint "a" is the smaller
+// (address, port) pair, so both directions of a flow map to the same key.
+typedef struct FlowKey
+{
+    uint8_t layer_3_type = PackedRecord::NONE;
+    uint8_t layer_4_type = PackedRecord::NONE;
+    uint16_t port_a = 0;
+    uint16_t port_b = 0;
+    uint8_t addr_a[16] = {};
+    uint8_t addr_b[16] = {};
+
+    // `forward` is set to true if src is endpoint "a"
+    static FlowKey make(uint8_t layer_3_type, uint8_t layer_4_type,
+                        const uint8_t *src_addr, uint16_t src_port,
+                        const uint8_t *dst_addr, uint16_t dst_port,
+                        bool *forward = nullptr)
+    {
+        FlowKey key;
+        key.layer_3_type = layer_3_type;
+        key.layer_4_type = layer_4_type;
+        int c = std::memcmp(src_addr, dst_addr, 16);
+        bool src_first = c < 0 || (c == 0 && src_port <= dst_port);
+        if (src_first)
+        {
+            std::memcpy(key.addr_a, src_addr, 16);
+            std::memcpy(key.addr_b, dst_addr, 16);
+            key.port_a = src_port;
+            key.port_b = dst_port;
+        }
+        else
+        {
+            std::memcpy(key.addr_a, dst_addr, 16);
+            std::memcpy(key.addr_b, src_addr, 16);
+            key.port_a = dst_port;
+            key.port_b = src_port;
+        }
+        if (forward != nullptr)
+        {
+            *forward = src_first;
+        }
+        return key;
+    }
+
+    static FlowKey from_header(const PackedRecord::header_t &h, bool *forward = nullptr)
+    {
+        return make(h.layer_3_type, h.layer_4_type,
+                    h.layer_3_src_addr, h.layer_4_src_port,
+                    h.layer_3_dst_addr, h.layer_4_dst_port,
+                    forward);
+    }
+
+    bool operator==(const FlowKey &other) const
+    {
+        return std::memcmp(this, &other, sizeof(FlowKey)) == 0;
+    }
+
+    bool operator!=(const FlowKey &other) const
+    {
+        return !(*this == other);
+    }
+
+    // FNV-1a, stable across runs and hosts
+    uint64_t hash() const
+    {
+        const uint8_t *p = (const uint8_t *)this;
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < sizeof(FlowKey); i++)
+        {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+} flow_key_t;
+
+static_assert(sizeof(FlowKey) == 38, "FlowKey must not contain padding");
+
+struct FlowKeyHash
+{
+    size_t operator()(const FlowKey &key) const
+    {
+        return (size_t)key.hash();
+    }
+};
+
+#endif // INCLUDE_GUARD_FLOW_KEY_HPP
@@ -0,0 +1,157 @@
+#ifndef INCLUDE_GUARD_G711_HPP
+#define INCLUDE_GUARD_G711_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// ITU-T G.711 mu-law and A-law. the reference conversions below fill lookup
+// tables on first use, so encoding and decoding a buffer is one table load
+// per sample.
+namespace G711
+{
+    // mu-law uses the top 14 bits of a 16 bit sample
+    inline uint8_t linear_to_ulaw(int16_t sample)
+    {
+        const int bias = 0x21;
+        const int clip = 8159;
+        int value = sample >> 2;
+        uint8_t mask = 0xff;
+        if (value < 0)
+        {
+            value = -value;
+            mask = 0x7f;
+        }
+        if (value > clip)
+        {
+            value = clip;
+        }
+        value += bias;
+        int segment = 0;
+        while (segment < 8 && value >= (0x40 << segment))
+        {
+            segment++;
+        }
+        if (segment >= 8)
+        {
+            return (uint8_t)(0x7f ^ mask);
+        }
+        return (uint8_t)(((segment << 4) | ((value >> (segment + 1)) & 0x0f)) ^ mask);
+    }
+
+    inline int16_t ulaw_to_linear(uint8_t ulaw)
+    {
+        const int bias = 0x84;
+        ulaw = (uint8_t)~ulaw;
+        int value = ((ulaw & 0x0f) << 3) + bias;
+        value <<= (ulaw & 0x70) >> 4;
+        return (int16_t)((ulaw & 0x80) ? (bias - value) : (value - bias));
+    }
+
+    // A-law uses the top 13 bits of a 16 bit sample
+    inline uint8_t linear_to_alaw(int16_t sample)
+    {
+        int value = sample >> 3;
+        uint8_t mask = 0xd5;
+        if (value < 0)
+        {
+            value = -value - 1;
+            mask = 0x55;
+        }
+        int segment = 0;
+        while (segment < 8 && value >= (0x20 << segment))
+        {
+            segment++;
+        }
+        if (segment >= 8)
+        {
+            return (uint8_t)(0x7f ^ mask);
+        }
+        const int mantissa = segment < 2 ? (value >> 1) & 0x0f : (value >> segment) & 0x0f;
+        return (uint8_t)(((segment << 4) | mantissa) ^ mask);
+    }
+
+    inline int16_t alaw_to_linear(uint8_t alaw)
+    {
+        alaw ^= 0x55;
+        int value = (alaw & 0x0f) << 4;
+        const int segment = (alaw & 0x70) >> 4;
+        if (segment == 0)
+        {
+            value += 8;
+        }
+        else
+        {
+            value = (value + 0x108) << (segment - 1);
+        }
+        return (int16_t)((alaw & 0x80) ? value : -value);
+    }
+
+    typedef struct Tables
+    {
+        uint8_t ulaw[1 << 14];
+        uint8_t alaw[1 << 13];
+        int16_t ulaw_linear[256];
+        int16_t alaw_linear[256];
+
+        Tables()
+        {
+            for (int i = 0; i < (1 << 14); i++)
+            {
+                ulaw[i] = linear_to_ulaw((int16_t)(uint16_t)(i << 2));
+            }
+            for (int i = 0; i < (1 << 13); i++)
+            {
+                alaw[i] = linear_to_alaw((int16_t)(uint16_t)(i << 3));
+            }
+            for (int i = 0; i < 256; i++)
+            {
+                ulaw_linear[i] = ulaw_to_linear((uint8_t)i);
+                alaw_linear[i] = alaw_to_linear((uint8_t)i);
+            }
+        }
+    } tables_t;
+
+    inline const tables_t &tables()
+    {
+        static const tables_t instance;
+        return instance;
+    }
+
+    inline void encode_ulaw(const int16_t *in, size_t count, uint8_t *out)
+    {
+        const uint8_t *table = tables().ulaw;
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = table[(uint16_t)in[i] >> 2];
+        }
+    }
+
+    inline void encode_alaw(const int16_t *in, size_t count, uint8_t *out)
+    {
+        const uint8_t *table = tables().alaw;
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = table[(uint16_t)in[i] >> 3];
+        }
+    }
+
+    inline void decode_ulaw(const uint8_t *in, size_t count, int16_t *out)
+    {
+        const int16_t *table = tables().ulaw_linear;
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = table[in[i]];
+        }
+    }
+
+    inline void decode_alaw(const uint8_t *in, size_t count, int16_t *out)
+    {
+        const int16_t *table = tables().alaw_linear;
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = table[in[i]];
+        }
+    }
+}
+
+#endif // INCLUDE_GUARD_G711_HPP
@@ -0,0 +1,115 @@
+#ifndef INCLUDE_GUARD_HISTOGRAM_HPP
+#define INCLUDE_GUARD_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// fixed size log-linear histogram of non-negative integers, for latencies
+// and batch sizes. every power of two range is split into 16 buckets, so
+// percentiles are reported with at most 1/16 relative error. record() does
+// not allocate. not thread safe.
+class Histogram
+{
+public:
+    Histogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            buckets[i] = 0;
+        }
+        total = 0;
+        sum = 0;
+        max_value = 0;
+    }
+
+    void record(uint64_t value)
+    {
+        buckets[bucket_of(value)]++;
+        total++;
+        sum += value;
+        if (value > max_value)
+        {
+            max_value = value;
+        }
+    }
+
+    uint64_t count() const
+    {
+        return total;
+    }
+
+    uint64_t max() const
+    {
+        return max_value;
+    }
+
+    double mean() const
+    {
+        return total == 0 ? 0 : (double)sum / total;
+    }
+
+    // upper bound of the bucket holding the p-th percentile, 0 < p <= 100
+    uint64_t percentile(double p) const
+    {
+        if (total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                const uint64_t upper = upper_bound_of(i);
+                return upper < max_value ? upper : max_value;
+            }
+        }
+        return max_value;
+    }
+
+private:
+    static const size_t sub_bucket_bits = 4;
+    static const size_t sub_buckets = 1 << sub_bucket_bits;
+    static const size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    uint64_t buckets[bucket_count];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max_value;
+
+    // values below 16 get a bucket each, above that the top 5 bits select one
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < sub_buckets)
+        {
+            return (size_t)value;
+        }
+        const size_t msb = 63 - __builtin_clzll(value);
+        const size_t shift = msb - sub_bucket_bits;
+        return (shift + 1) * sub_buckets + (size_t)((value >> shift) & (sub_buckets - 1));
+    }
+
+    static uint64_t upper_bound_of(size_t index)
+    {
+        if (index < sub_buckets)
+        {
+            return index;
+        }
+        const size_t shift = index / sub_buckets - 1;
+        const uint64_t low = ((uint64_t)(sub_buckets + index % sub_buckets)) << shift;
+        return low + ((uint64_t)1 << shift) - 1;
+    }
+};
+
+#endif // INCLUDE_GUARD_HISTOGRAM_HPP
@@ -0,0 +1,252 @@
+#ifndef INCLUDE_GUARD_PACKED_RECORD_HPP
+#define INCLUDE_GUARD_PACKED_RECORD_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// binary form of a captured datagram, stored by `capture --record-format packed`
+// as the single field "record" of a stream entry. header only and independent
+// of libtins, so consumers can include it to decode entries.
+//
+// layout, all integers little endian:
+//
+//   offset size
+//        0    1  version (3)
+//        1    1  layer_2_type   (PackedRecord::type)
+//        2    1  layer_3_type
+//        3    1  layer_4_type
+//        4    1  payload_type
+//        5    1  payload_compression (PackedRecord::compression)
+//        6    2  reserved, 0
+//        8    8  capture timestamp [us since epoch]
+//       16    6  layer_2_src_addr
+//       22    6  layer_2_dst_addr
+//       28   16  layer_3_src_addr (IPv4 in the first 4 bytes, network order)
+//       44   16  layer_3_dst_addr
+//       60    2  layer_4_src_port
+//       62    2  layer_4_dst_port
+//       64    4  payload_size
+//       68    4  uncompressed payload size, 0 if payload_compression is none
+//       72    4  metadata_size
+//       76       metadata, metadata_size bytes
+//                payload, payload_size bytes as stored
+//
+// metadata holds the string fields of PackedRecord::metadata_names in that
+// order, each a 2 byte length and its bytes, so encapsulation and SIP call
+// fields survive the packed form.
+//
+// version 1 had a 2 byte uncompressed size at offset 6 and no field at 68,
+// version 2 had no metadata and the payload at 72.
+namespace PackedRecord
+{
+    const uint8_t version = 3;
+    const size_t header_size = 76;
+
+    // string fields of a datagram kept in the metadata section
+    const size_t metadata_fields = 8;
+    const char *const metadata_names[metadata_fields] = {
+        "vlan_ids", "mpls_labels", "tunnel_type", "tunnel_id",
+        "media_type", "call_id", "sip_from", "sip_to"};
+
+    typedef struct Metadata
+    {
+        // indexed like metadata_names, empty if not set
+        std::string values[metadata_fields];
+    } metadata_t;
+
+    enum type : uint8_t
+    {
+        NONE = 0,
+        ETHERNET_II = 1,
+        ARP = 2,
+        IP = 3,
+        IPv6 = 4,
+        TCP = 5,
+        UDP = 6,
+        ICMP = 7,
+        ICMPv6 = 8,
+        OTHER = 255,
+    };
+
+    enum compression : uint8_t
+    {
+        UNCOMPRESSED = 0,
+        LZ4 = 1,  // lz4 block
+        ZSTD = 2, // zstd frame
+    };
+
+    typedef struct Header
+    {
+        uint8_t layer_2_type = NONE;
+        uint8_t layer_3_type = NONE;
+        uint8_t layer_4_type = NONE;
+        uint8_t payload_type = NONE;
+        uint8_t payload_compression = UNCOMPRESSED;
+        uint32_t payload_uncompressed_size = 0;
+        uint64_t timestamp_usec = 0;
+        uint8_t layer_2_src_addr[6] = {};
+        uint8_t layer_2_dst_addr[6] = {};
+        uint8_t layer_3_src_addr[16] = {};
+        uint8_t layer_3_dst_addr[16] = {};
+        uint16_t layer_4_src_port = 0;
+        uint16_t layer_4_dst_port = 0;
+        uint32_t payload_size = 0;
+    } header_t;
+
+    inline void put_le(char *p, uint64_t v, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            p[i] = (char)((v >> (8 * i)) & 0xff);
+        }
+    }
+
+    inline uint64_t get_le(const char *p, size_t n)
+    {
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            v |= (uint64_t)(uint8_t)p[i] << (8 * i);
+        }
+        return v;
+    }
+
+    // replaces `out` with header, metadata and payload. the stored payload_size
+    // is `size`, header.payload_size is not used. `metadata` points to
+    // metadata_fields strings indexed like metadata_names, nullptr for none.
+    // a field longer than 65535 bytes is cut there.
+    inline void encode(const header_t &header, const uint8_t *payload, size_t size, std::string &out,
+                       const std::string *const *metadata = nullptr)
+    {
+        size_t metadata_size = 0;
+        if (metadata != nullptr)
+        {
+            for (size_t i = 0; i < metadata_fields; i++)
+            {
+                metadata_size += 2 + std::min(metadata[i]->size(), (size_t)0xffff);
+            }
+        }
+        out.resize(header_size + metadata_size + size);
+        char *p = &out[0];
+        p[0] = (char)version;
+        p[1] = (char)header.layer_2_type;
+        p[2] = (char)header.layer_3_type;
+        p[3] = (char)header.layer_4_type;
+        p[4] = (char)header.payload_type;
+        p[5] = (char)header.payload_compression;
+        put_le(p + 6, 0, 2);
+        put_le(p + 8, header.timestamp_usec, 8);
+        std::memcpy(p + 16, header.layer_2_src_addr, 6);
+        std::memcpy(p + 22, header.layer_2_dst_addr, 6);
+        std::memcpy(p + 28, header.layer_3_src_addr, 16);
+        std::memcpy(p + 44, header.layer_3_dst_addr, 16);
+        put_le(p + 60, header.layer_4_src_port, 2);
+        put_le(p + 62, header.layer_4_dst_port, 2);
+        put_le(p + 64, size, 4);
+        put_le(p + 68, header.payload_uncompressed_size, 4);
+        put_le(p + 72, metadata_size, 4);
+        char *m = p + header_size;
+        if (metadata != nullptr)
+        {
+            for (size_t i = 0; i < metadata_fields; i++)
+            {
+                const size_t n = std::min(metadata[i]->size(), (size_t)0xffff);
+                put_le(m, n, 2);
+                if (n > 0)
+                {
+                    std::memcpy(m + 2, metadata[i]->data(), n);
+                }
+                m += 2 + n;
+            }
+        }
+        if (size > 0)
+        {
+            std::memcpy(m, payload, size);
+        }
+    }
+
+    // returns false if `data` is not a complete record of a known version.
+    // on success `payload` points into `data`, and `metadata` if given is
+    // filled from the metadata section.
+    inline bool decode(const char *data, size_t size, header_t &header, const uint8_t *&payload,
+                       metadata_t *metadata = nullptr)
+    {
+        if (size < header_size || (uint8_t)data[0] != version)
+        {
+            return false;
+        }
+        header.layer_2_type = (uint8_t)data[1];
+        header.layer_3_type = (uint8_t)data[2];
+        header.layer_4_type = (uint8_t)data[3];
+        header.payload_type = (uint8_t)data[4];
+        header.payload_compression = (uint8_t)data[5];
+        header.timestamp_usec = get_le(data + 8, 8);
+        std::memcpy(header.layer_2_src_addr, data + 16, 6);
+        std::memcpy(header.layer_2_dst_addr, data + 22, 6);
+        std::memcpy(header.layer_3_src_addr, data + 28, 16);
+        std::memcpy(header.layer_3_dst_addr, data + 44, 16);
+        header.layer_4_src_port = (uint16_t)get_le(data + 60, 2);
+        header.layer_4_dst_port = (uint16_t)get_le(data + 62, 2);
+        header.payload_size = (uint32_t)get_le(data + 64, 4);
+        header.payload_uncompressed_size = (uint32_t)get_le(data + 68, 4);
+        const size_t metadata_size = (size_t)get_le(data + 72, 4);
+        if (size - header_size < metadata_size ||
+            size - header_size - metadata_size < header.payload_size)
+        {
+            return false;
+        }
+        if (metadata != nullptr)
+        {
+            const char *m = data + header_size;
+            const char *end = m + metadata_size;
+            for (size_t i = 0; i < metadata_fields; i++)
+            {
+                metadata->values[i].clear();
+                if (end - m < 2)
+                {
+                    continue;
+                }
+                const size_t n = (size_t)get_le(m, 2);
+                if ((size_t)(end - m - 2) < n)
+                {
+                    return false;
+                }
+                metadata->values[i].assign(m + 2, n);
+                m += 2 + n;
+            }
+        }
+        payload = (const uint8_t *)data + header_size + metadata_size;
+        return true;
+    }
+
+    inline const char *type_to_string(uint8_t t)
+    {
+        switch (t)
+        {
+        case NONE:
+            return "";
+        case ETHERNET_II:
+            return "ETHERNET_II";
+        case ARP:
+            return "ARP";
+        case IP:
+            return "IP";
+        case IPv6:
+            return "IPv6";
+        case TCP:
+            return "TCP";
+        case UDP:
+            return "UDP";
+        case ICMP:
+            return "ICMP";
+        case ICMPv6:
+            return "ICMPv6";
+        default:
+            return "OTHER";
+        }
+    }
+}
+
+#endif // INCLUDE_GUARD_PACKED_RECORD_HPP
@@ -0,0 +1,89 @@
+#ifndef INCLUDE_GUARD_RTP_HEADER_HPP
+#define INCLUDE_GUARD_RTP_HEADER_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// RTP fixed header (RFC 3550) of a UDP payload. CSRCs, the header extension
+// and padding are skipped, so `payload` is the media only. header only and
+// independent of libtins.
+namespace RtpHeader
+{
+    const size_t fixed_size = 12;
+
+    // static payload types of RFC 3551 that are recorded or decoded
+    enum payload_type : uint8_t
+    {
+        PCMU = 0,
+        PCMA = 8,
+    };
+
+    typedef struct Header
+    {
+        bool marker = false;
+        uint8_t payload_type = 0;
+        uint16_t sequence = 0;
+        uint32_t timestamp = 0;
+        uint32_t ssrc = 0;
+        // into the parsed buffer
+        const uint8_t *payload = nullptr;
+        size_t payload_size = 0;
+    } header_t;
+
+    inline uint16_t get_be16(const uint8_t *p)
+    {
+        return (uint16_t)(p[0] << 8 | p[1]);
+    }
+
+    inline uint32_t get_be32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    // returns false if `data` is not an RTP version 2 packet. RTCP on the
+    // same port (RFC 5761, payload types 64..95) is rejected as well.
+    inline bool parse(const uint8_t *data, size_t size, header_t &header)
+    {
+        if (size < fixed_size || (data[0] >> 6) != 2)
+        {
+            return false;
+        }
+        header.marker = (data[1] & 0x80) != 0;
+        header.payload_type = data[1] & 0x7f;
+        if (header.payload_type >= 64 && header.payload_type <= 95)
+        {
+            return false;
+        }
+        header.sequence = get_be16(data + 2);
+        header.timestamp = get_be32(data + 4);
+        header.ssrc = get_be32(data + 8);
+
+        size_t offset = fixed_size + 4 * (size_t)(data[0] & 0x0f);
+        if ((data[0] & 0x10) != 0)
+        {
+            if (offset + 4 > size)
+            {
+                return false;
+            }
+            offset += 4 + 4 * (size_t)get_be16(data + offset + 2);
+        }
+        if (offset > size)
+        {
+            return false;
+        }
+        size_t padding = 0;
+        if ((data[0] & 0x20) != 0)
+        {
+            padding = data[size - 1];
+            if (padding == 0 || padding > size - offset)
+            {
+                return false;
+            }
+        }
+        header.payload = data + offset;
+        header.payload_size = size - offset - padding;
+        return true;
+    }
+}
+
+#endif // INCLUDE_GUARD_RTP_HEADER_HPP
@@ -1,9 +1,14 @@
+#ifndef INCLUDE_GUARD_SAFE_QUEUE_HPP
+#define INCLUDE_GUARD_SAFE_QUEUE_HPP
+
 #include <iostream>
 #include <thread>
 #include <mutex>
 #include <vector>
 #include <string>
-#include <queue>
+#include <utility>
+#include <iterator>
+#include "batch-queue.hpp"
 
 class EmptyQueue : std::exception {
 public:
@@ -13,45 +18,73 @@ public:
 };
 
 template <typename T>
-class SafeQueue {
+class SafeQueue : public BatchQueue<T> {
 public:
     SafeQueue() {}
-    SafeQueue(SafeQueue const& other) {
+    SafeQueue(SafeQueue const&) = delete;
+    SafeQueue& operator=(SafeQueue const&) = delete;
+    SafeQueue(SafeQueue&& other) {
         std::lock_guard<std::mutex> lock(other._mutex);
-        _queue = other.que;
+        _queue = std::move(other._queue);
+        _head = other._head;
+        other._head = 0;
     }
-    SafeQueue& operator=(SafeQueue const&) = delete;
+    SafeQueue& operator=(SafeQueue&&) = delete;
 
-    void push(T value) {
+    void push(const T& value) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(value);
+    }
+    void push(T&& value) override {
         std::lock_guard<std::mutex> lock(_mutex);
-        _queue.push(value);
+        _queue.push_back(std::move(value));
+    }
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.emplace_back(std::forward<Args>(args)...);
     }
 
     void pop(T& res) {
         std::lock_guard<std::mutex> lock(_mutex);
-        if(_queue.empty()) throw EmptyQueue();
-        res = _queue.front();
-        _queue.pop();
+        if(_head == _queue.size()) throw EmptyQueue();
+        res = std::move(_queue[_head++]);
+        if(_head == _queue.size()) {
+            _queue.clear();
+            _head = 0;
+        }
     }
-    std::shared_ptr<T> pop() {
+
+    // take every queued element at once. `out` is cleared and handed back
+    // to the queue, so its capacity is reused by the next producer pushes.
+    void swap(std::vector<T>& out) override {
+        out.clear();
         std::lock_guard<std::mutex> lock(_mutex);
-        if(_queue.empty()) throw EmptyQueue();
-        auto const res = std::make_shared<T>(_queue.front());
-        _queue.pop();
-        return res;
+        if(_head != 0) {
+            out.insert(out.end(),
+                       std::make_move_iterator(_queue.begin() + _head),
+                       std::make_move_iterator(_queue.end()));
+            _queue.clear();
+            _head = 0;
+        } else {
+            _queue.swap(out);
+        }
     }
 
     bool empty() const {
         std::lock_guard<std::mutex> lock(_mutex);
-        return _queue.empty();
+        return _head == _queue.size();
     }
 
-    size_t size() const {
+    size_t size() const override {
         std::lock_guard<std::mutex> lock(_mutex);
-        return _queue.size();
+        return _queue.size() - _head;
     }
 
 private:
-    std::queue<T> _queue;
+    std::vector<T> _queue;
+    size_t _head = 0;
     mutable std::mutex _mutex;
-};
\ No newline at end of file
+};
+
+#endif // INCLUDE_GUARD_SAFE_QUEUE_HPP
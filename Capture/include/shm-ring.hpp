@@ -0,0 +1,342 @@
+#ifndef INCLUDE_GUARD_SHM_RING_HPP
+#define INCLUDE_GUARD_SHM_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// single producer / multiple consumer ring of variable size entries in
+// POSIX shared memory. `capture --sinks shm` is the producer; consumers on
+// the same host open the same name with ShmRing::Reader and read entries
+// in place, without copies and without slowing the producer down.
+// a consumer that falls more than the ring size behind loses entries and
+// continues from the oldest one still present.
+// the ring is left in place when the producer exits. a restarted producer
+// continues its offsets and bumps `epoch`, consumers then continue from the
+// newest entry, so they never have to be restarted with capture.
+// header only, so consumers only need this file.
+//
+// layout: header_t, then `capacity` bytes of entries. an entry is an
+// 8 byte entry_t followed by `size` bytes, padded to 8 bytes. entries do
+// not wrap; the end of the ring is filled with a padding entry instead.
+// offsets in the header grow forever, the position in the ring is
+// offset % capacity.
+namespace ShmRing
+{
+    const char magic[8] = {'B', 'S', 'N', 'R', 'I', 'N', 'G', '1'};
+    const uint32_t version = 2;
+
+    typedef struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t capacity;
+        // end of the last complete entry
+        std::atomic<uint64_t> write_offset;
+        // start of the oldest entry not yet overwritten
+        std::atomic<uint64_t> oldest_offset;
+        // counts producers that opened the ring, capacity may change with it
+        std::atomic<uint64_t> epoch;
+    } header_t;
+
+    typedef struct Entry
+    {
+        uint32_t size;
+        uint32_t flags;
+    } entry_t;
+
+    const uint32_t entry_padding = 1;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring offsets must be lock free to be shared between processes");
+
+    inline uint64_t entry_space(size_t size)
+    {
+        return (sizeof(entry_t) + size + 7) & ~(uint64_t)7;
+    }
+
+    // maps `name`, read write and created with at least `size` bytes if
+    // `create` is set, otherwise read only. `mapped_size` is the size of the
+    // object, a producer never shrinks it under the mappings of consumers.
+    inline void *map(const std::string &name, size_t size, bool create, size_t &mapped_size)
+    {
+        int fd = create ? shm_open(name.c_str(), O_CREAT | O_RDWR, 0644) : shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("shm_open: " + name + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::runtime_error("fstat: " + name + ": " + std::strerror(error));
+        }
+        if (create && (size_t)st.st_size < size && ftruncate(fd, size) != 0)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::runtime_error("ftruncate: " + name + ": " + std::strerror(error));
+        }
+        if (!create)
+        {
+            if ((size_t)st.st_size < sizeof(header_t))
+            {
+                close(fd);
+                throw std::runtime_error("shm: " + name + ": not a ring");
+            }
+            size = st.st_size;
+        }
+        size = std::max(size, (size_t)st.st_size);
+        void *p = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            throw std::runtime_error("mmap: " + name + ": " + std::strerror(errno));
+        }
+        mapped_size = size;
+        return p;
+    }
+
+    class Writer
+    {
+    public:
+        // creates the ring `name`, e.g. "/basin-capture", or continues the
+        // ring an earlier producer left. `capacity` is rounded up to a
+        // multiple of 8. with an unchanged capacity the earlier entries stay
+        // readable, otherwise the ring starts empty at the earlier offset.
+        Writer(const std::string &name, size_t capacity)
+        {
+            this->capacity = (capacity + 7) & ~(size_t)7;
+            header = (header_t *)map(name, sizeof(header_t) + this->capacity, true, mapped_size);
+            data = (uint8_t *)header + sizeof(header_t);
+
+            const bool earlier = std::memcmp(header->magic, ShmRing::magic, sizeof(header->magic)) == 0 &&
+                                 header->version == ShmRing::version && header->header_size == sizeof(header_t);
+            const uint64_t written = earlier ? header->write_offset.load(std::memory_order_relaxed) : 0;
+            const uint64_t oldest = earlier && header->capacity == this->capacity ? header->oldest_offset.load(std::memory_order_relaxed) : written;
+            const uint64_t epoch = earlier ? header->epoch.load(std::memory_order_relaxed) + 1 : 0;
+            header->capacity = this->capacity;
+            header->oldest_offset.store(oldest, std::memory_order_relaxed);
+            header->write_offset.store(written, std::memory_order_relaxed);
+            header->header_size = sizeof(header_t);
+            header->version = ShmRing::version;
+            std::memcpy(header->magic, ShmRing::magic, sizeof(header->magic));
+            header->epoch.store(epoch, std::memory_order_release);
+        }
+
+        // the ring stays for the next producer and the current consumers
+        ~Writer()
+        {
+            munmap(header, mapped_size);
+        }
+
+        Writer(Writer const &) = delete;
+        Writer &operator=(Writer const &) = delete;
+
+        // space for an entry of `size` bytes, or nullptr if it can never fit.
+        // the entry becomes visible with commit().
+        uint8_t *reserve(size_t size)
+        {
+            const uint64_t space = entry_space(size);
+            if (space > capacity)
+            {
+                return nullptr;
+            }
+            uint64_t offset = header->write_offset.load(std::memory_order_relaxed);
+            const uint64_t position = offset % capacity;
+            if (position + space > capacity)
+            {
+                // pad to the end of the ring, the entry starts at position 0
+                const uint64_t padding = capacity - position;
+                make_room(offset + padding);
+                entry_t *pad = (entry_t *)(data + position);
+                pad->size = (uint32_t)(padding - sizeof(entry_t));
+                pad->flags = entry_padding;
+                offset += padding;
+                header->write_offset.store(offset, std::memory_order_release);
+            }
+            make_room(offset + space);
+            entry_t *entry = (entry_t *)(data + offset % capacity);
+            entry->size = (uint32_t)size;
+            entry->flags = 0;
+            reserved_space = space;
+            return (uint8_t *)(entry + 1);
+        }
+
+        void commit()
+        {
+            const uint64_t offset = header->write_offset.load(std::memory_order_relaxed);
+            header->write_offset.store(offset + reserved_space, std::memory_order_release);
+        }
+
+    private:
+        size_t capacity;
+        size_t mapped_size;
+        header_t *header;
+        uint8_t *data;
+        uint64_t reserved_space = 0;
+
+        // moves oldest_offset past the entries overwritten up to `end`,
+        // before they are overwritten
+        void make_room(uint64_t end)
+        {
+            uint64_t oldest = header->oldest_offset.load(std::memory_order_relaxed);
+            const uint64_t written = header->write_offset.load(std::memory_order_relaxed);
+            while (oldest < written && oldest + capacity < end)
+            {
+                const entry_t *entry = (const entry_t *)(data + oldest % capacity);
+                oldest += entry_space(entry->size);
+            }
+            if (oldest + capacity < end)
+            {
+                oldest = end - capacity;
+            }
+            header->oldest_offset.store(oldest, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+    };
+
+    class Reader
+    {
+    public:
+        // opens an existing ring read only. reading starts at the newest entry.
+        explicit Reader(const std::string &name)
+        {
+            this->name = name;
+            header = nullptr;
+            open();
+            offset = header->write_offset.load(std::memory_order_acquire);
+            lost_entries = 0;
+        }
+
+        ~Reader()
+        {
+            munmap((void *)header, mapped_size);
+        }
+
+        Reader(Reader const &) = delete;
+        Reader &operator=(Reader const &) = delete;
+
+        // points `entry` at the next entry in the ring, false if there is none.
+        // the bytes may be overwritten while they are read, so check with
+        // release() before trusting them.
+        bool peek(const uint8_t *&entry, size_t &size)
+        {
+            while (true)
+            {
+                if (header->epoch.load(std::memory_order_acquire) != epoch)
+                {
+                    // a new producer. with the same capacity it kept the
+                    // entries, otherwise reading continues with its first one
+                    const uint64_t previous_capacity = capacity;
+                    open();
+                    const uint64_t oldest = header->oldest_offset.load(std::memory_order_acquire);
+                    if (capacity != previous_capacity || offset < oldest)
+                    {
+                        lost_entries += offset != oldest;
+                        offset = oldest;
+                    }
+                }
+                const uint64_t written = header->write_offset.load(std::memory_order_acquire);
+                if (offset >= written)
+                {
+                    return false;
+                }
+                const uint64_t oldest = header->oldest_offset.load(std::memory_order_acquire);
+                if (offset < oldest)
+                {
+                    lost_entries++;
+                    offset = oldest;
+                    continue;
+                }
+                const uint64_t position = offset % capacity;
+                const entry_t *e = (const entry_t *)(data + position);
+                const entry_t copy = *e;
+                if (position + sizeof(entry_t) + copy.size > capacity)
+                {
+                    // overwritten while it was read, continue from the oldest
+                    // entry, or from the newest if the ring is corrupt
+                    lost_entries++;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    const uint64_t resync = header->oldest_offset.load(std::memory_order_acquire);
+                    offset = resync > offset ? resync : written;
+                    continue;
+                }
+                if (copy.flags & entry_padding)
+                {
+                    offset += entry_space(copy.size);
+                    continue;
+                }
+                entry = (const uint8_t *)(e + 1);
+                size = copy.size;
+                current_space = entry_space(copy.size);
+                return true;
+            }
+        }
+
+        // moves past the entry returned by peek(). false if the producer
+        // overwrote it in the meantime.
+        bool release()
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const bool intact = header->oldest_offset.load(std::memory_order_acquire) <= offset &&
+                                header->epoch.load(std::memory_order_acquire) == epoch;
+            offset += current_space;
+            if (!intact)
+            {
+                lost_entries++;
+            }
+            return intact;
+        }
+
+        // overruns seen so far, at least one entry lost each
+        uint64_t lost() const
+        {
+            return lost_entries;
+        }
+
+    private:
+        std::string name;
+        const header_t *header;
+        size_t mapped_size;
+        const uint8_t *data;
+        uint64_t capacity;
+        uint64_t epoch;
+        uint64_t offset;
+        uint64_t current_space = 0;
+        uint64_t lost_entries;
+
+        // maps the ring again, the object may have grown with the capacity
+        // of a new producer
+        void open()
+        {
+            if (header != nullptr)
+            {
+                munmap((void *)header, mapped_size);
+                header = nullptr;
+            }
+            header = (const header_t *)map(name, 0, false, mapped_size);
+            if (std::memcmp(header->magic, ShmRing::magic, sizeof(header->magic)) != 0 || header->version != ShmRing::version ||
+                header->header_size + header->capacity > mapped_size)
+            {
+                munmap((void *)header, mapped_size);
+                header = nullptr;
+                throw std::runtime_error("shm: " + name + ": not a ring");
+            }
+            epoch = header->epoch.load(std::memory_order_acquire);
+            capacity = header->capacity;
+            data = (const uint8_t *)header + header->header_size;
+        }
+    };
+}
+
+#endif // INCLUDE_GUARD_SHM_RING_HPP
@@ -0,0 +1,250 @@
+#include "decapsulator.hpp"
+
+namespace
+{
+    const uint8_t ip_protocol_ipip = 4;
+    const uint8_t ip_protocol_ipv6 = 41;
+    const uint8_t ip_protocol_gre = 47;
+
+    const uint16_t ethertype_ipv4 = 0x0800;
+    const uint16_t ethertype_ipv6 = 0x86dd;
+    const uint16_t ethertype_transparent_ethernet = 0x6558;
+
+    inline uint16_t read_be16(const uint8_t *p)
+    {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    inline uint32_t read_be32(const uint8_t *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+}
+
+Decapsulator::Decapsulator(const config_t &c)
+{
+    config = c;
+}
+
+const Decapsulator::config_t &Decapsulator::get_config() const
+{
+    return config;
+}
+
+Decapsulator::tunnel_t Decapsulator::inspect(const Tins::PDU &pdu, layers_t &layers) const
+{
+    tunnel_t tunnel;
+
+    for (const Tins::PDU *p = &pdu; p != nullptr; p = p->inner_pdu())
+    {
+        switch (p->pdu_type())
+        {
+        case Tins::PDU::DOT1Q:
+            append(layers.vlan_ids, static_cast<const Tins::Dot1Q *>(p)->id());
+            break;
+        case Tins::PDU::MPLS:
+            append(layers.mpls_labels, static_cast<const Tins::MPLS *>(p)->label());
+            break;
+        case Tins::PDU::IP:
+        case Tins::PDU::IPv6:
+        {
+            const Tins::PDU *inner = p->inner_pdu();
+            if (inner == nullptr)
+            {
+                break;
+            }
+            if (inner->pdu_type() == Tins::PDU::IP || inner->pdu_type() == Tins::PDU::IPv6)
+            {
+                tunnel.type = IPIP;
+                tunnel.inner_pdu = inner;
+            }
+            else if (inner->pdu_type() == Tins::PDU::RAW)
+            {
+                const uint8_t protocol = p->pdu_type() == Tins::PDU::IP
+                                             ? static_cast<const Tins::IP *>(p)->protocol()
+                                             : static_cast<const Tins::IPv6 *>(p)->next_header();
+                if (protocol == ip_protocol_gre)
+                {
+                    inspect_gre(*static_cast<const Tins::RawPDU *>(inner), tunnel);
+                }
+                else if (protocol == ip_protocol_ipip || protocol == ip_protocol_ipv6)
+                {
+                    // libtins could not parse the inner header, do not route on it
+                    tunnel.type = IPIP;
+                }
+            }
+            break;
+        }
+        case Tins::PDU::UDP:
+        {
+            const Tins::UDP *udp = static_cast<const Tins::UDP *>(p);
+            const Tins::PDU *inner = p->inner_pdu();
+            if (inner != nullptr && inner->pdu_type() == Tins::PDU::RAW &&
+                (udp->dport() == config.vxlan_port || udp->sport() == config.vxlan_port))
+            {
+                inspect_vxlan(*static_cast<const Tins::RawPDU *>(inner), tunnel);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (tunnel.type != NO_TUNNEL)
+        {
+            break;
+        }
+    }
+
+    // tunnel_ids keeps one position per tunnel, empty for tunnels without an id
+    const bool first_tunnel = layers.tunnel_types.empty();
+    switch (tunnel.type)
+    {
+    case IPIP:
+        append(layers.tunnel_types, "IPIP");
+        break;
+    case GRE:
+        append(layers.tunnel_types, "GRE");
+        break;
+    case VXLAN:
+        append(layers.tunnel_types, "VXLAN");
+        break;
+    default:
+        return tunnel;
+    }
+    if (!first_tunnel)
+    {
+        layers.tunnel_ids.push_back(',');
+    }
+    if (tunnel.has_id)
+    {
+        layers.tunnel_ids.append(std::to_string(tunnel.id));
+    }
+    return tunnel;
+}
+
+std::unique_ptr<Tins::PDU> Decapsulator::build_inner(const tunnel_t &tunnel)
+{
+    if (tunnel.inner_data == nullptr || tunnel.inner_size == 0)
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        switch (tunnel.inner_kind)
+        {
+        case INNER_ETHERNET:
+            return std::unique_ptr<Tins::PDU>(new Tins::EthernetII(tunnel.inner_data, (uint32_t)tunnel.inner_size));
+        case INNER_IP:
+            return std::unique_ptr<Tins::PDU>(new Tins::IP(tunnel.inner_data, (uint32_t)tunnel.inner_size));
+        case INNER_IPv6:
+            return std::unique_ptr<Tins::PDU>(new Tins::IPv6(tunnel.inner_data, (uint32_t)tunnel.inner_size));
+        default:
+            return nullptr;
+        }
+    }
+    catch (std::exception &e)
+    {
+        return nullptr;
+    }
+}
+
+bool Decapsulator::inspect_gre(const Tins::RawPDU &raw, tunnel_t &tunnel) const
+{
+    const uint8_t *p = raw.payload().data();
+    const size_t size = raw.payload_size();
+    if (size < 4)
+    {
+        return false;
+    }
+
+    const uint16_t flags = read_be16(p);
+    if ((flags & 0x0007) != 0)
+    {
+        // only version 0, not PPTP's enhanced GRE
+        return false;
+    }
+    const uint16_t protocol = read_be16(p + 2);
+    size_t offset = 4;
+    if (flags & 0x8000)
+    {
+        offset += 4; // checksum and reserved
+    }
+    if (flags & 0x2000)
+    {
+        if (size < offset + 4)
+        {
+            return false;
+        }
+        tunnel.id = read_be32(p + offset);
+        tunnel.has_id = true;
+        offset += 4;
+    }
+    if (flags & 0x1000)
+    {
+        offset += 4; // sequence number
+    }
+    if (size <= offset)
+    {
+        return false;
+    }
+
+    tunnel.type = GRE;
+    switch (protocol)
+    {
+    case ethertype_ipv4:
+        tunnel.inner_kind = INNER_IP;
+        break;
+    case ethertype_ipv6:
+        tunnel.inner_kind = INNER_IPv6;
+        break;
+    case ethertype_transparent_ethernet:
+        tunnel.inner_kind = INNER_ETHERNET;
+        break;
+    default:
+        return true;
+    }
+    tunnel.inner_data = p + offset;
+    tunnel.inner_size = size - offset;
+    return true;
+}
+
+bool Decapsulator::inspect_vxlan(const Tins::RawPDU &raw, tunnel_t &tunnel) const
+{
+    const uint8_t *p = raw.payload().data();
+    const size_t size = raw.payload_size();
+    // flags(1) with the I bit, reserved(3), VNI(3), reserved(1)
+    if (size <= 8 || (p[0] & 0x08) == 0)
+    {
+        return false;
+    }
+
+    tunnel.type = VXLAN;
+    tunnel.id = ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 8) | p[6];
+    tunnel.has_id = true;
+    tunnel.inner_kind = INNER_ETHERNET;
+    tunnel.inner_data = p + 8;
+    tunnel.inner_size = size - 8;
+    return true;
+}
+
+void Decapsulator::append(std::string &list, uint32_t value)
+{
+    char digits[16];
+    int n = snprintf(digits, sizeof(digits), "%u", value);
+    if (!list.empty())
+    {
+        list.push_back(',');
+    }
+    list.append(digits, n);
+}
+
+void Decapsulator::append(std::string &list, const char *value)
+{
+    if (!list.empty())
+    {
+        list.push_back(',');
+    }
+    list.append(value);
+}
@@ -0,0 +1,84 @@
+#ifndef INCLUDE_GUARD_DECAPSULATOR_HPP
+#define INCLUDE_GUARD_DECAPSULATOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tins/tins.h>
+
+// finds VLAN (802.1Q / QinQ) tags, MPLS labels and IP-in-IP, GRE and VXLAN
+// tunnels in a parsed packet. inspect() only walks the existing PDU chain
+// and reads tunnel headers in place; a PDU chain for the tunneled packet is
+// built only when the caller wants to route on it.
+class Decapsulator
+{
+public:
+    typedef struct Config
+    {
+        bool enabled = false;
+        // take the datagram fields from the innermost packet
+        bool route_inner = false;
+        uint16_t vxlan_port = 4789;
+    } config_t;
+
+    enum TunnelType
+    {
+        NO_TUNNEL,
+        IPIP,
+        GRE,
+        VXLAN,
+    };
+
+    enum InnerKind
+    {
+        INNER_NONE,
+        INNER_ETHERNET,
+        INNER_IP,
+        INNER_IPv6,
+    };
+
+    typedef struct Tunnel
+    {
+        TunnelType type = NO_TUNNEL;
+        uint32_t id = 0;
+        bool has_id = false;
+        // IP-in-IP: inner layer already parsed by libtins
+        const Tins::PDU *inner_pdu = nullptr;
+        // GRE / VXLAN: tunneled packet, points into the outer payload
+        InnerKind inner_kind = INNER_NONE;
+        const uint8_t *inner_data = nullptr;
+        size_t inner_size = 0;
+    } tunnel_t;
+
+    // comma separated, outermost first, accumulated across inspect() calls.
+    // tunnel_ids has a position for every tunnel_types entry, e.g. "IPIP,VXLAN"
+    // and ",100"
+    typedef struct Layers
+    {
+        std::string vlan_ids = "";
+        std::string mpls_labels = "";
+        std::string tunnel_types = "";
+        std::string tunnel_ids = "";
+    } layers_t;
+
+    explicit Decapsulator(const config_t &c);
+
+    // records tags of `pdu` into `layers` and returns the first tunnel found.
+    tunnel_t inspect(const Tins::PDU &pdu, layers_t &layers) const;
+
+    // builds the tunneled packet of a GRE or VXLAN tunnel. nullptr if it
+    // cannot be parsed or `tunnel` has no packet bytes.
+    static std::unique_ptr<Tins::PDU> build_inner(const tunnel_t &tunnel);
+
+    const config_t &get_config() const;
+
+private:
+    config_t config;
+
+    bool inspect_gre(const Tins::RawPDU &raw, tunnel_t &tunnel) const;
+    bool inspect_vxlan(const Tins::RawPDU &raw, tunnel_t &tunnel) const;
+    static void append(std::string &list, uint32_t value);
+    static void append(std::string &list, const char *value);
+};
+
+#endif // INCLUDE_GUARD_DECAPSULATOR_HPP
@@ -0,0 +1,210 @@
+#include "flow-table.hpp"
+
+namespace
+{
+    const uint8_t tcp_fin = 0x01;
+    const uint8_t tcp_rst = 0x04;
+
+    // expired flows are looked for at most this often
+    const uint64_t expiry_interval_usec = 1000000;
+}
+
+FlowTable::FlowTable(const config_t &c, BatchQueue<record_t> *out)
+{
+    config = c;
+    this->out = out;
+    count = 0;
+    next_expiry_usec = 0;
+
+    // at most half full, so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < config.max_flows * 2)
+    {
+        capacity *= 2;
+    }
+    slots.resize(capacity);
+    mask = capacity - 1;
+
+    port_selected.assign(65536, false);
+    for (uint16_t port : config.packet_ports)
+    {
+        port_selected[port] = true;
+    }
+}
+
+void FlowTable::update(const flow_key_t &key, bool forward, uint64_t timestamp_usec, size_t bytes, uint8_t tcp_flags)
+{
+    if (timestamp_usec >= next_expiry_usec)
+    {
+        expire(timestamp_usec);
+    }
+
+    const uint64_t hash = key.hash();
+    slot_t *slot = find_or_insert(key, hash);
+    if (slot == nullptr)
+    {
+        // table full, the packet is exported as a flow of its own
+        record_t record;
+        record.key = key;
+        record.first_seen_usec = timestamp_usec;
+        record.last_seen_usec = timestamp_usec;
+        (forward ? record.packets_a_to_b : record.packets_b_to_a) = 1;
+        (forward ? record.bytes_a_to_b : record.bytes_b_to_a) = bytes;
+        record.tcp_flags = tcp_flags;
+        export_record(record, LACK_OF_RESOURCES);
+        return;
+    }
+
+    record_t &record = slot->record;
+    if (record.first_seen_usec == 0)
+    {
+        record.first_seen_usec = timestamp_usec;
+    }
+    record.last_seen_usec = timestamp_usec;
+    if (forward)
+    {
+        record.packets_a_to_b++;
+        record.bytes_a_to_b += bytes;
+    }
+    else
+    {
+        record.packets_b_to_a++;
+        record.bytes_b_to_a += bytes;
+    }
+    record.tcp_flags |= tcp_flags;
+
+    if (tcp_flags & tcp_fin)
+    {
+        slot->fin |= forward ? 1 : 2;
+    }
+    if ((tcp_flags & tcp_rst) || slot->fin == 3)
+    {
+        export_record(record, END_OF_FLOW);
+        remove(slot - slots.data());
+    }
+}
+
+bool FlowTable::selects(uint16_t sport, uint16_t dport) const
+{
+    return port_selected[sport] || port_selected[dport];
+}
+
+void FlowTable::flush()
+{
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        if (slots[i].used)
+        {
+            export_record(slots[i].record, FORCED_END);
+            slots[i] = slot_t();
+        }
+    }
+    count = 0;
+    out->flush();
+}
+
+size_t FlowTable::size() const
+{
+    return count;
+}
+
+FlowTable::slot_t *FlowTable::find_or_insert(const flow_key_t &key, uint64_t hash)
+{
+    size_t i = (size_t)hash & mask;
+    while (slots[i].used)
+    {
+        if (slots[i].hash == hash && slots[i].record.key == key)
+        {
+            return &slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+    if (count >= config.max_flows)
+    {
+        return nullptr;
+    }
+    slots[i].used = true;
+    slots[i].hash = hash;
+    slots[i].record.key = key;
+    count++;
+    return &slots[i];
+}
+
+void FlowTable::expire(uint64_t now_usec)
+{
+    expire_slots(now_usec);
+    next_expiry_usec = now_usec + expiry_interval_usec;
+    out->flush();
+}
+
+void FlowTable::expire_slots(uint64_t now_usec)
+{
+    const uint64_t idle_usec = (uint64_t)config.idle_timeout_sec * 1000000;
+    const uint64_t active_usec = (uint64_t)config.active_timeout_sec * 1000000;
+
+    size_t i = 0;
+    while (i < slots.size())
+    {
+        slot_t &slot = slots[i];
+        if (!slot.used)
+        {
+            i++;
+            continue;
+        }
+        record_t &record = slot.record;
+        // a wall clock `now_usec` may lag behind the latest packet
+        if (record.last_seen_usec > now_usec)
+        {
+            i++;
+            continue;
+        }
+        if (now_usec - record.last_seen_usec >= idle_usec)
+        {
+            // nothing to report if the flow was idle since its last active export
+            if (record.packets_a_to_b + record.packets_b_to_a > 0)
+            {
+                export_record(record, IDLE_TIMEOUT);
+            }
+            // remove() may move a later entry into slot i, look at it again
+            remove(i);
+            continue;
+        }
+        if (record.first_seen_usec != 0 && record.first_seen_usec <= now_usec &&
+            now_usec - record.first_seen_usec >= active_usec)
+        {
+            export_record(record, ACTIVE_TIMEOUT);
+            record_t next;
+            next.key = record.key;
+            next.last_seen_usec = record.last_seen_usec;
+            record = next;
+        }
+        i++;
+    }
+}
+
+void FlowTable::export_record(const record_t &record, uint8_t reason)
+{
+    record_t exported = record;
+    exported.end_reason = reason;
+    out->push(std::move(exported));
+}
+
+// backward shift deletion, keeps every probe sequence free of holes
+void FlowTable::remove(size_t index)
+{
+    size_t hole = index;
+    size_t i = (index + 1) & mask;
+    while (slots[i].used)
+    {
+        const size_t home = (size_t)slots[i].hash & mask;
+        // move slots[i] into the hole unless its home lies in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    slots[hole] = slot_t();
+    count--;
+}
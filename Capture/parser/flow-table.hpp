@@ -0,0 +1,101 @@
+#ifndef INCLUDE_GUARD_FLOW_TABLE_HPP
+#define INCLUDE_GUARD_FLOW_TABLE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "batch-queue.hpp"
+#include "flow-key.hpp"
+
+// per flow packet and byte counters, exported as flow records instead of
+// one stream entry per packet, in the spirit of IPFIX / NetFlow.
+// flows live in an open addressing table with linear probing, sized once
+// at construction. a flow is exported when it has been idle or active for
+// too long, when TCP closes it, or when the table is flushed. timeouts are
+// measured in capture time.
+// not thread safe, each parser owns one.
+class FlowTable
+{
+public:
+    typedef struct Config
+    {
+        bool enabled = false;
+        // flows tracked at the same time
+        size_t max_flows = 65536;
+        int idle_timeout_sec = 15;
+        // long running flows are exported at this interval and keep counting
+        int active_timeout_sec = 60;
+        // packets of flows from or to these ports are still stored one by one
+        std::vector<uint16_t> packet_ports;
+    } config_t;
+
+    // IPFIX flowEndReason
+    enum EndReason : uint8_t
+    {
+        IDLE_TIMEOUT = 1,
+        ACTIVE_TIMEOUT = 2,
+        END_OF_FLOW = 3,
+        FORCED_END = 4,
+        LACK_OF_RESOURCES = 5,
+    };
+
+    typedef struct Record
+    {
+        // endpoint "a" and "b" as in flow_key_t
+        flow_key_t key;
+        uint64_t first_seen_usec = 0;
+        uint64_t last_seen_usec = 0;
+        uint64_t packets_a_to_b = 0;
+        uint64_t bytes_a_to_b = 0;
+        uint64_t packets_b_to_a = 0;
+        uint64_t bytes_b_to_a = 0;
+        // TCP flags seen in either direction
+        uint8_t tcp_flags = 0;
+        uint8_t end_reason = 0;
+    } record_t;
+
+    FlowTable(const config_t &c, BatchQueue<record_t> *out);
+    FlowTable(FlowTable const &) = delete;
+    FlowTable &operator=(FlowTable const &) = delete;
+
+    // counts one packet of `key`. `forward` is the direction returned by
+    // flow_key_t::make, `bytes` the layer 3 size.
+    void update(const flow_key_t &key, bool forward, uint64_t timestamp_usec, size_t bytes, uint8_t tcp_flags);
+
+    // true if the packet should still be stored one by one
+    bool selects(uint16_t sport, uint16_t dport) const;
+
+    // exports every flow, at the end of a capture file
+    void flush();
+
+    // exports flows idle or active for too long at `now_usec`. update()
+    // does this once a second of capture time, a live capture that goes
+    // quiet calls it on the wall clock.
+    void expire(uint64_t now_usec);
+
+    size_t size() const;
+
+private:
+    typedef struct Slot
+    {
+        record_t record;
+        uint64_t hash = 0;
+        // FIN seen from a / from b
+        uint8_t fin = 0;
+        bool used = false;
+    } slot_t;
+
+    config_t config;
+    BatchQueue<record_t> *out;
+    std::vector<slot_t> slots;
+    size_t mask;
+    size_t count;
+    std::vector<bool> port_selected;
+    uint64_t next_expiry_usec;
+
+    slot_t *find_or_insert(const flow_key_t &key, uint64_t hash);
+    void expire_slots(uint64_t now_usec);
+    void export_record(const record_t &record, uint8_t reason);
+    void remove(size_t index);
+};
+
+#endif // INCLUDE_GUARD_FLOW_TABLE_HPP
@@ -0,0 +1,354 @@
+#include "ip-defragmenter.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const size_t max_datagram_size = 65535;
+    // entries of completed or dropped datagrams stay in `order` until it
+    // grows past this multiple of max_datagrams
+    const size_t max_order_per_datagram = 2;
+
+    inline uint16_t read_be16(const uint8_t *p)
+    {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    inline uint32_t read_be32(const uint8_t *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    inline void write_be16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)(v >> 8);
+        p[1] = (uint8_t)(v & 0xff);
+    }
+
+    uint16_t ipv4_header_checksum(const uint8_t *p, size_t size)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            sum += read_be16(p + i);
+        }
+        while (sum >> 16)
+        {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        return (uint16_t)~sum;
+    }
+}
+
+bool IpDefragmenter::FragmentKey::operator==(const FragmentKey &other) const
+{
+    return std::memcmp(this, &other, sizeof(FragmentKey)) == 0;
+}
+
+size_t IpDefragmenter::FragmentKeyHash::operator()(const FragmentKey &key) const
+{
+    const uint8_t *p = (const uint8_t *)&key;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(FragmentKey); i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+IpDefragmenter::IpDefragmenter(const config_t &c)
+{
+    config = c;
+}
+
+IpDefragmenter::Status IpDefragmenter::process(Tins::PDU &pdu, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled)
+{
+    expire(timestamp_usec);
+
+    const Tins::IP *ip_p = pdu.find_pdu<Tins::IP>();
+    if (ip_p != nullptr)
+    {
+        return process_ipv4(pdu, *ip_p, timestamp_usec, reassembled);
+    }
+
+    const Tins::IPv6 *ipv6_p = pdu.find_pdu<Tins::IPv6>();
+    if (ipv6_p != nullptr)
+    {
+        return process_ipv6(pdu, *ipv6_p, timestamp_usec, reassembled);
+    }
+
+    return NOT_FRAGMENTED;
+}
+
+size_t IpDefragmenter::size() const
+{
+    return table.size();
+}
+
+IpDefragmenter::Status IpDefragmenter::process_ipv4(Tins::PDU &pdu, const Tins::IP &ip, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled)
+{
+    if (!ip.is_fragmented())
+    {
+        return NOT_FRAGMENTED;
+    }
+
+    Tins::IP copy(ip);
+    const Tins::PDU::serialization_type bytes = copy.serialize();
+    if (bytes.size() < 20)
+    {
+        return NOT_FRAGMENTED;
+    }
+    const size_t header_size = (bytes[0] & 0x0f) * 4;
+    const size_t total_length = read_be16(&bytes[2]);
+    if (header_size < 20 || total_length < header_size || total_length > bytes.size())
+    {
+        return NOT_FRAGMENTED;
+    }
+
+    fragment_key_t key;
+    key.id = read_be16(&bytes[4]);
+    key.layer_3_type = 4;
+    key.protocol = bytes[9];
+    std::memcpy(key.src_addr, &bytes[12], 4);
+    std::memcpy(key.dst_addr, &bytes[16], 4);
+
+    const uint16_t flags_offset = read_be16(&bytes[6]);
+    const bool more_fragments = (flags_offset & 0x2000) != 0;
+    const uint32_t offset = (flags_offset & 0x1fff) * 8;
+
+    if (!add(key, timestamp_usec, bytes.data(), header_size, offset,
+             bytes.data() + header_size, total_length - header_size, more_fragments))
+    {
+        return FRAGMENT_HELD;
+    }
+
+    // whole datagram: clear fragment fields, fix length and checksum
+    const size_t whole_header_size = (whole[0] & 0x0f) * 4;
+    write_be16(&whole[2], (uint16_t)whole.size());
+    whole[6] = 0;
+    whole[7] = 0;
+    whole[10] = 0;
+    whole[11] = 0;
+    write_be16(&whole[10], ipv4_header_checksum(whole.data(), whole_header_size));
+
+    try
+    {
+        reassembled = replace_layer(pdu, Tins::PDU::IP, new Tins::IP(whole.data(), (uint32_t)whole.size()));
+    }
+    catch (std::exception &e)
+    {
+        return FRAGMENT_HELD;
+    }
+    return reassembled ? REASSEMBLED : FRAGMENT_HELD;
+}
+
+IpDefragmenter::Status IpDefragmenter::process_ipv6(Tins::PDU &pdu, const Tins::IPv6 &ipv6, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled)
+{
+    if (ipv6.search_header(Tins::IPv6::FRAGMENT) == nullptr)
+    {
+        return NOT_FRAGMENTED;
+    }
+
+    Tins::IPv6 copy(ipv6);
+    const Tins::PDU::serialization_type bytes = copy.serialize();
+    if (bytes.size() < 40)
+    {
+        return NOT_FRAGMENTED;
+    }
+    const size_t end = 40 + read_be16(&bytes[4]);
+    if (end > bytes.size())
+    {
+        return NOT_FRAGMENTED;
+    }
+
+    // walk the extension headers up to the fragment header
+    uint8_t next_header = bytes[6];
+    size_t offset = 40;
+    while (next_header != 44)
+    {
+        size_t length;
+        if (offset + 2 > end)
+        {
+            return NOT_FRAGMENTED;
+        }
+        switch (next_header)
+        {
+        case 0:  // hop-by-hop
+        case 43: // routing
+        case 60: // destination options
+            length = (bytes[offset + 1] + 1) * 8;
+            break;
+        case 51: // authentication
+            length = (bytes[offset + 1] + 2) * 4;
+            break;
+        default:
+            return NOT_FRAGMENTED;
+        }
+        next_header = bytes[offset];
+        offset += length;
+    }
+    if (offset + 8 > end)
+    {
+        return NOT_FRAGMENTED;
+    }
+
+    fragment_key_t key;
+    key.id = read_be32(&bytes[offset + 4]);
+    key.layer_3_type = 6;
+    key.protocol = bytes[offset];
+    std::memcpy(key.src_addr, &bytes[8], 16);
+    std::memcpy(key.dst_addr, &bytes[24], 16);
+
+    const uint16_t offset_flags = read_be16(&bytes[offset + 2]);
+    const bool more_fragments = (offset_flags & 0x0001) != 0;
+    const uint32_t fragment_offset = offset_flags & 0xfff8;
+
+    // unfragmentable extension headers are not kept, the fixed header
+    // points directly at the layer 4 protocol
+    uint8_t header[40];
+    std::memcpy(header, bytes.data(), 40);
+    header[6] = key.protocol;
+
+    if (!add(key, timestamp_usec, header, sizeof(header), fragment_offset,
+             bytes.data() + offset + 8, end - (offset + 8), more_fragments))
+    {
+        return FRAGMENT_HELD;
+    }
+
+    write_be16(&whole[4], (uint16_t)(whole.size() - 40));
+
+    try
+    {
+        reassembled = replace_layer(pdu, Tins::PDU::IPv6, new Tins::IPv6(whole.data(), (uint32_t)whole.size()));
+    }
+    catch (std::exception &e)
+    {
+        return FRAGMENT_HELD;
+    }
+    return reassembled ? REASSEMBLED : FRAGMENT_HELD;
+}
+
+bool IpDefragmenter::add(const fragment_key_t &key, uint64_t now_usec,
+                         const uint8_t *header, size_t header_size,
+                         uint32_t offset, const uint8_t *data, size_t size, bool more_fragments)
+{
+    auto it = table.find(key);
+    if (it == table.end())
+    {
+        while (table.size() >= config.max_datagrams && !order.empty())
+        {
+            auto oldest = table.find(order.front().first);
+            if (oldest != table.end() && oldest->second.first_seen_usec == order.front().second)
+            {
+                table.erase(oldest);
+            }
+            order.pop_front();
+        }
+        it = table.emplace(key, incomplete_t()).first;
+        it->second.first_seen_usec = now_usec;
+        order.emplace_back(key, now_usec);
+        if (order.size() > max_order_per_datagram * config.max_datagrams)
+        {
+            compact();
+        }
+    }
+    incomplete_t &incomplete = it->second;
+
+    if (offset + size + header_size > max_datagram_size)
+    {
+        table.erase(it);
+        return false;
+    }
+
+    if (offset == 0)
+    {
+        incomplete.header.assign(header, header + header_size);
+    }
+    if (!more_fragments)
+    {
+        incomplete.total_size = offset + size;
+        incomplete.has_total_size = true;
+    }
+    if (incomplete.payload.size() < offset + size)
+    {
+        incomplete.payload.resize(offset + size);
+    }
+    std::memcpy(incomplete.payload.data() + offset, data, size);
+    incomplete.ranges.emplace_back(offset, offset + size);
+
+    if (!incomplete.has_total_size || incomplete.header.empty())
+    {
+        return false;
+    }
+
+    std::sort(incomplete.ranges.begin(), incomplete.ranges.end());
+    uint32_t covered = 0;
+    for (const auto &range : incomplete.ranges)
+    {
+        if (range.first > covered)
+        {
+            return false;
+        }
+        covered = std::max(covered, range.second);
+    }
+    if (covered < incomplete.total_size)
+    {
+        return false;
+    }
+
+    whole.assign(incomplete.header.begin(), incomplete.header.end());
+    whole.insert(whole.end(), incomplete.payload.begin(), incomplete.payload.begin() + incomplete.total_size);
+    table.erase(it);
+    return true;
+}
+
+void IpDefragmenter::expire(uint64_t now_usec)
+{
+    const uint64_t timeout_usec = (uint64_t)config.timeout_sec * 1000000;
+    while (!order.empty() && order.front().second + timeout_usec <= now_usec)
+    {
+        auto it = table.find(order.front().first);
+        if (it != table.end() && it->second.first_seen_usec == order.front().second)
+        {
+            table.erase(it);
+        }
+        order.pop_front();
+    }
+}
+
+void IpDefragmenter::compact()
+{
+    std::deque<std::pair<fragment_key_t, uint64_t>> kept;
+    for (const auto &entry : order)
+    {
+        auto it = table.find(entry.first);
+        if (it != table.end() && it->second.first_seen_usec == entry.second)
+        {
+            kept.push_back(entry);
+        }
+    }
+    order.swap(kept);
+}
+
+std::unique_ptr<Tins::PDU> IpDefragmenter::replace_layer(Tins::PDU &pdu, Tins::PDU::PDUType type, Tins::PDU *layer)
+{
+    std::unique_ptr<Tins::PDU> replacement(layer);
+    if (pdu.pdu_type() == type)
+    {
+        return replacement;
+    }
+
+    std::unique_ptr<Tins::PDU> top(pdu.clone());
+    Tins::PDU *p = top.get();
+    while (p->inner_pdu() != nullptr && p->inner_pdu()->pdu_type() != type)
+    {
+        p = p->inner_pdu();
+    }
+    if (p->inner_pdu() == nullptr)
+    {
+        return nullptr;
+    }
+    p->inner_pdu(replacement.release());
+    return top;
+}
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_GUARD_IP_DEFRAGMENTER_HPP
+#define INCLUDE_GUARD_IP_DEFRAGMENTER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <tins/tins.h>
+
+// reassembles IPv4 and IPv6 fragments, so layer 4 parsing and stream
+// routing see whole datagrams. incomplete datagrams are kept in a bounded
+// table and dropped after a timeout measured in capture time.
+// not thread safe, each parser owns one.
+class IpDefragmenter
+{
+public:
+    typedef struct Config
+    {
+        bool enabled = false;
+        // incomplete datagrams kept at the same time, the oldest is dropped first
+        size_t max_datagrams = 4096;
+        int timeout_sec = 30;
+    } config_t;
+
+    enum Status
+    {
+        NOT_FRAGMENTED,
+        FRAGMENT_HELD,
+        REASSEMBLED,
+    };
+
+    explicit IpDefragmenter(const config_t &c);
+    IpDefragmenter(IpDefragmenter const &) = delete;
+    IpDefragmenter &operator=(IpDefragmenter const &) = delete;
+
+    // on REASSEMBLED, `reassembled` holds a copy of `pdu` whose IP layer
+    // carries the whole datagram.
+    Status process(Tins::PDU &pdu, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled);
+
+    size_t size() const;
+
+private:
+    typedef struct FragmentKey
+    {
+        uint32_t id = 0;
+        uint8_t layer_3_type = 0;
+        uint8_t protocol = 0;
+        uint8_t reserved[2] = {};
+        uint8_t src_addr[16] = {};
+        uint8_t dst_addr[16] = {};
+
+        bool operator==(const FragmentKey &other) const;
+    } fragment_key_t;
+
+    struct FragmentKeyHash
+    {
+        size_t operator()(const FragmentKey &key) const;
+    };
+
+    typedef struct Incomplete
+    {
+        uint64_t first_seen_usec = 0;
+        // IP header of the first fragment, layer 4 protocol already in place
+        std::vector<uint8_t> header;
+        std::vector<uint8_t> payload;
+        // received [begin, end) ranges of payload
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        uint32_t total_size = 0;
+        bool has_total_size = false;
+    } incomplete_t;
+
+    config_t config;
+    std::unordered_map<fragment_key_t, incomplete_t, FragmentKeyHash> table;
+    // insertion order, for expiry and eviction. entries of datagrams no
+    // longer in `table` are skipped and compacted away.
+    std::deque<std::pair<fragment_key_t, uint64_t>> order;
+    std::vector<uint8_t> whole;
+
+    void expire(uint64_t now_usec);
+    // drops `order` entries of datagrams no longer in `table`
+    void compact();
+    bool add(const fragment_key_t &key, uint64_t now_usec,
+             const uint8_t *header, size_t header_size,
+             uint32_t offset, const uint8_t *data, size_t size, bool more_fragments);
+    Status process_ipv4(Tins::PDU &pdu, const Tins::IP &ip, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled);
+    Status process_ipv6(Tins::PDU &pdu, const Tins::IPv6 &ipv6, uint64_t timestamp_usec, std::unique_ptr<Tins::PDU> &reassembled);
+    static std::unique_ptr<Tins::PDU> replace_layer(Tins::PDU &pdu, Tins::PDU::PDUType type, Tins::PDU *layer);
+};
+
+#endif // INCLUDE_GUARD_IP_DEFRAGMENTER_HPP
@@ -2,22 +2,386 @@
 #include <iomanip>
 #include <sstream>
 #include <queue>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 #include <tins/tins.h>
 
 Parser *Parser::thisPtr;
 
-Parser::Parser(config_t &c, SafeQueue<datagram_t> *s)
+namespace
+{
+    // tunnels followed with route_inner, e.g. VXLAN carrying GRE
+    const int max_tunnel_depth = 4;
+
+    // FNV-1a, the same stream goes to the same writer on every run
+    size_t stream_key_hash(const std::string &key)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (char ch : key)
+        {
+            h ^= (uint8_t)ch;
+            h *= 1099511628211ULL;
+        }
+        return (size_t)h;
+    }
+}
+
+Parser::Parser(config_t &c, BatchQueue<datagram_t> *s, BatchQueue<FlowTable::record_t> *flow_queue)
+    : Parser(c, std::vector<BatchQueue<datagram_t> *>{s}, flow_queue)
+{
+}
+
+Parser::Parser(config_t &c, const std::vector<BatchQueue<datagram_t> *> &s, BatchQueue<FlowTable::record_t> *flow_queue)
 {
     Parser::thisPtr = this;
     config = c;
-    safe_queue = s;
+    queues = s;
+    if (queues.empty())
+    {
+        throw std::invalid_argument("parser needs at least one queue");
+    }
+    default_stream_key = config.stream_prefix + config.default_stream;
+    compressor.reset(new PayloadCompressor(config.compression));
+    if (config.ip_defragment.enabled)
+    {
+        defragmenter.reset(new IpDefragmenter(config.ip_defragment));
+    }
+    if (config.tcp_reassembly.enabled)
+    {
+        reassembler.reset(new TcpReassembler(config.tcp_reassembly));
+    }
+    if (config.decapsulation.enabled)
+    {
+        decapsulator.reset(new Decapsulator(config.decapsulation));
+    }
+    if (config.flows.enabled)
+    {
+        if (flow_queue == nullptr)
+        {
+            throw std::invalid_argument("flow accounting needs a flow queue");
+        }
+        flow_table.reset(new FlowTable(config.flows, flow_queue));
+    }
+    sampler.reset(new Sampler(config.sampling));
+    // streams divided by call need the Call-ID of every datagram
+    if (config.sip.enabled || config.divide_streams == "call")
+    {
+        sip_tracker.reset(new SipTracker(config.sip));
+    }
 }
 
-bool Parser::parse(Tins::PDU &pdu)
+uint64_t Parser::sampled_out() const
+{
+    return sampler->sampled_out();
+}
+
+void Parser::flush()
+{
+    if (flow_table)
+    {
+        flow_table->flush();
+    }
+}
+
+void Parser::expire(uint64_t now_usec)
+{
+    if (flow_table)
+    {
+        flow_table->expire(now_usec);
+    }
+}
+
+bool Parser::parse(Tins::Packet &packet)
 {
     Parser *_this = Parser::thisPtr;
+    if (packet.pdu() == nullptr)
+    {
+        return true;
+    }
     datagram_t datagram;
+    datagram.header.timestamp_usec = std::chrono::microseconds(packet.timestamp()).count();
+
+    // fragments are held until the whole datagram can be parsed
+    Tins::Packet *packet_p = &packet;
+    Tins::Packet reassembled_packet;
+    if (_this->defragmenter)
+    {
+        std::unique_ptr<Tins::PDU> reassembled;
+        switch (_this->defragmenter->process(*packet.pdu(), datagram.header.timestamp_usec, reassembled))
+        {
+        case IpDefragmenter::FRAGMENT_HELD:
+            return true;
+        case IpDefragmenter::REASSEMBLED:
+            reassembled_packet = Tins::Packet(*reassembled, packet.timestamp());
+            packet_p = &reassembled_packet;
+            break;
+        default:
+            break;
+        }
+    }
+    Tins::PDU &pdu = *packet_p->pdu();
+
+    // with route_inner the fields below describe the innermost tunneled packet
+    const Tins::PDU *route_p = &pdu;
+    if (_this->decapsulator)
+    {
+        const bool route_inner = _this->decapsulator->get_config().route_inner;
+        Decapsulator::layers_t layers;
+        _this->tunneled_pdus.clear();
+        for (int depth = 0; depth < max_tunnel_depth; depth++)
+        {
+            const Decapsulator::tunnel_t tunnel = _this->decapsulator->inspect(*route_p, layers);
+            if (tunnel.type == Decapsulator::NO_TUNNEL || !route_inner)
+            {
+                break;
+            }
+            if (tunnel.inner_pdu != nullptr)
+            {
+                route_p = tunnel.inner_pdu;
+                continue;
+            }
+            std::unique_ptr<Tins::PDU> inner = Decapsulator::build_inner(tunnel);
+            if (!inner)
+            {
+                break;
+            }
+            route_p = inner.get();
+            _this->tunneled_pdus.push_back(std::move(inner));
+        }
+        datagram.vlan_ids = std::move(layers.vlan_ids);
+        datagram.mpls_labels = std::move(layers.mpls_labels);
+        datagram.tunnel_type = std::move(layers.tunnel_types);
+        datagram.tunnel_id = std::move(layers.tunnel_ids);
+    }
+
+    // payload of the innermost layer that carries one
+    const Tins::RawPDU *raw_p = nullptr;
+    const Tins::TCP *tcp_p = fill_layer_3_4(datagram, *route_p, raw_p);
+    if (!fill_layer_2(datagram, *route_p, raw_p) && route_p != &pdu)
+    {
+        // layer 3 tunnels carry no link layer, keep the outer one without its payload
+        fill_layer_2(datagram, pdu, raw_p, false);
+    }
 
+    // with flow accounting only packets of selected flows, and SIP calls
+    // and their media if they are tracked, become stream entries
+    bool selected = true;
+    if (_this->flow_table)
+    {
+        if (datagram.header.layer_3_type != PackedRecord::NONE)
+        {
+            const Tins::PDU *layer_3_p = route_p->find_pdu<Tins::IP>();
+            if (layer_3_p == nullptr)
+            {
+                layer_3_p = route_p->find_pdu<Tins::IPv6>();
+            }
+            bool forward = true;
+            const flow_key_t key = flow_key_t::from_header(datagram.header, &forward);
+            const uint8_t tcp_flags = tcp_p != nullptr ? (uint8_t)(tcp_p->flags() & 0xff) : 0;
+            _this->flow_table->update(key, forward, datagram.header.timestamp_usec, layer_3_p->size(), tcp_flags);
+        }
+        selected = _this->flow_table->selects(datagram.header.layer_4_src_port, datagram.header.layer_4_dst_port);
+    }
+
+    const uint8_t *payload_data = nullptr;
+    size_t payload_size = 0;
+    if (raw_p != nullptr)
+    {
+        payload_data = raw_p->payload().data();
+        payload_size = raw_p->payload_size();
+    }
+
+    // signalling and media are told apart before flow selection and
+    // sampling, so every SIP message updates the media table
+    if (_this->sip_tracker)
+    {
+        const SipTracker::call_t *call = nullptr;
+        datagram.media = _this->sip_tracker->process(datagram.header, payload_data, payload_size, call);
+        static const char *const media_types[] = {"", "sip", "rtp", "rtcp", ""};
+        datagram.media_type = media_types[datagram.media];
+        if (call != nullptr)
+        {
+            datagram.call_id = call->call_id;
+            datagram.sip_from = call->from;
+            datagram.sip_to = call->to;
+        }
+        selected = selected || (datagram.media != SipTracker::OTHER && datagram.media != SipTracker::UNTRACKED);
+    }
+    if (!selected)
+    {
+        return true;
+    }
+
+    // TCP payload of followed streams is replaced by what the stream released in order
+    if (tcp_p != nullptr && _this->reassembler && route_p == &pdu)
+    {
+        const flow_key_t key = flow_key_t::from_header(datagram.header);
+        if (_this->reassembler->process(*packet_p, key, _this->reassembly_buffer) && tcp_p->find_pdu<Tins::RawPDU>() != nullptr)
+        {
+            if (_this->reassembly_buffer.empty())
+            {
+                // retransmission or out of order, nothing new to emit
+                return true;
+            }
+            payload_data = _this->reassembly_buffer.data();
+            payload_size = _this->reassembly_buffer.size();
+        }
+    }
+
+    if (raw_p != nullptr)
+    {
+        datagram.payload_size = std::to_string(payload_size);
+        datagram.header.payload_size = payload_size;
+    }
+
+    // sampled out packets are counted but never encoded. reassembly above
+    // still sees every segment.
+    if (_this->sampler->enabled() && !_this->sampler->keep(datagram.header, datagram.call_id))
+    {
+        return true;
+    }
+
+    if (_this->compressor->enabled())
+    {
+        datagram.payload_compression = "none";
+        if (raw_p != nullptr &&
+            _this->compressor->selects(datagram.header.layer_4_src_port, datagram.header.layer_4_dst_port) &&
+            _this->compressor->compress(payload_data, payload_size, _this->compression_buffer))
+        {
+            datagram.payload_compression = _this->compressor->method();
+            datagram.header.payload_compression = _this->compressor->record_compression();
+            datagram.header.payload_uncompressed_size = (uint32_t)payload_size;
+            payload_data = _this->compression_buffer.data();
+            payload_size = _this->compression_buffer.size();
+        }
+    }
+
+    const bool packed = _this->config.record_format == "packed";
+    if (packed || _this->config.build_record)
+    {
+        // indexed like PackedRecord::metadata_names
+        const std::string *const metadata[PackedRecord::metadata_fields] = {
+            &datagram.vlan_ids, &datagram.mpls_labels, &datagram.tunnel_type, &datagram.tunnel_id,
+            &datagram.media_type, &datagram.call_id, &datagram.sip_from, &datagram.sip_to};
+        PackedRecord::encode(datagram.header, payload_data, payload_size, datagram.record, metadata);
+    }
+    if (!packed && raw_p != nullptr)
+    {
+        if (_this->config.payload_convert_method == "hex")
+        {
+            datagram.payload_encoding_type = "hex";
+            datagram.payload = uint8_array_to_hex_string(payload_data, payload_size);
+        }
+        else
+        {
+            datagram.payload_encoding_type = "base64";
+            datagram.payload = uint8_array_to_base64_string(payload_data, payload_size);
+        }
+    }
+
+    std::cout << datagram.layer_2_type << " "
+              << datagram.layer_2_src_addr << " -> "
+              << datagram.layer_2_dst_addr << ", "
+              << datagram.layer_3_type << " "
+              << datagram.layer_3_src_addr << " -> "
+              << datagram.layer_3_dst_addr << ", "
+              << datagram.layer_4_type << " "
+              << datagram.layer_4_src_port << " -> "
+              << datagram.layer_4_dst_port << " (Payload: "
+              << datagram.payload_type << ", "
+              << datagram.payload_size << " bytes)"
+              << std::endl;
+
+    _this->assign_stream_keys(datagram);
+    datagram.enqueued_usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    _this->route(std::move(datagram));
+
+    return true;
+}
+
+void Parser::assign_stream_keys(datagram_t &datagram) const
+{
+    const std::string *src_addr = nullptr;
+    const std::string *dst_addr = nullptr;
+    if (config.divide_streams == "mac")
+    {
+        src_addr = &datagram.layer_2_src_addr;
+        dst_addr = &datagram.layer_2_dst_addr;
+    }
+    else if (config.divide_streams == "ip")
+    {
+        src_addr = &datagram.layer_3_src_addr;
+        dst_addr = &datagram.layer_3_dst_addr;
+    }
+    else if (config.divide_streams == "call")
+    {
+        // signalling and media of a call share one stream, written once
+        if (datagram.call_id.empty())
+        {
+            datagram.stream_key = default_stream_key;
+        }
+        else
+        {
+            datagram.stream_key.assign(config.stream_prefix).append(datagram.call_id);
+        }
+        return;
+    }
+    else
+    {
+        datagram.stream_key = default_stream_key;
+        return;
+    }
+
+    // an address that is missing sends the datagram to the default stream as well
+    std::string *key = &datagram.stream_key;
+    if (src_addr->empty() || dst_addr->empty())
+    {
+        *key = default_stream_key;
+        key = &datagram.second_stream_key;
+    }
+    if (!src_addr->empty())
+    {
+        key->assign(config.stream_prefix).append(*src_addr);
+        key = &datagram.second_stream_key;
+    }
+    if (!dst_addr->empty())
+    {
+        key->assign(config.stream_prefix).append(*dst_addr);
+    }
+}
+
+// every stream key maps to one queue, so entries of a stream keep their order
+void Parser::route(datagram_t &&datagram)
+{
+    if (queues.size() == 1)
+    {
+        queues[0]->push(std::move(datagram));
+        return;
+    }
+
+    const size_t first = stream_key_hash(datagram.stream_key) % queues.size();
+    if (datagram.second_stream_key.empty() ||
+        stream_key_hash(datagram.second_stream_key) % queues.size() == first)
+    {
+        queues[first]->push(std::move(datagram));
+        return;
+    }
+
+    // the streams belong to different writers, each gets a copy with its key
+    datagram_t copy = datagram;
+    copy.stream_key.swap(copy.second_stream_key);
+    copy.second_stream_key.clear();
+    copy.copy = true;
+    const size_t second = stream_key_hash(copy.stream_key) % queues.size();
+    datagram.second_stream_copied = true;
+    queues[first]->push(std::move(datagram));
+    queues[second]->push(std::move(copy));
+}
+
+const Tins::TCP *Parser::fill_layer_3_4(datagram_t &datagram, const Tins::PDU &pdu, const Tins::RawPDU *&raw_p)
+{
     // TCP?
     const Tins::TCP *tcp_p = pdu.find_pdu<Tins::TCP>();
     if (tcp_p != nullptr)
@@ -25,25 +389,10 @@ bool Parser::parse(Tins::PDU &pdu)
         datagram.layer_4_type = pdutype_to_string(tcp_p->pdu_type());
         datagram.layer_4_src_port = std::to_string(tcp_p->sport());
         datagram.layer_4_dst_port = std::to_string(tcp_p->dport());
-
-        if (datagram.payload_type == "")
-        {
-            if (tcp_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(tcp_p->pdu_type());
-                datagram.payload_size = std::to_string(tcp_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(tcp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(tcp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
-        }
+        datagram.header.layer_4_type = PackedRecord::TCP;
+        datagram.header.layer_4_src_port = tcp_p->sport();
+        datagram.header.layer_4_dst_port = tcp_p->dport();
+        find_payload(datagram, *tcp_p, raw_p);
     }
 
     // UDP?
@@ -53,27 +402,10 @@ bool Parser::parse(Tins::PDU &pdu)
         datagram.layer_4_type = pdutype_to_string(udp_p->pdu_type());
         datagram.layer_4_src_port = std::to_string(udp_p->sport());
         datagram.layer_4_dst_port = std::to_string(udp_p->dport());
-
-        if (datagram.payload_type == "")
-        {
-            if (udp_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(udp_p->pdu_type());
-                datagram.payload_size = std::to_string(udp_p->find_pdu<Tins::RawPDU>()->payload_size());
-                const Tins::RawPDU::payload_type &udp_payload = udp_p->find_pdu<Tins::RawPDU>()->payload();
-
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(udp_payload);
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(udp_payload);
-                }
-            }
-        }
+        datagram.header.layer_4_type = PackedRecord::UDP;
+        datagram.header.layer_4_src_port = udp_p->sport();
+        datagram.header.layer_4_dst_port = udp_p->dport();
+        find_payload(datagram, *udp_p, raw_p);
     }
 
     // ICMP?
@@ -81,25 +413,8 @@ bool Parser::parse(Tins::PDU &pdu)
     if (icmp_p != nullptr)
     {
         datagram.layer_4_type = pdutype_to_string(icmp_p->pdu_type());
-
-        if (datagram.payload_type == "")
-        {
-            if (icmp_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(icmp_p->pdu_type());
-                datagram.payload_size = std::to_string(icmp_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(icmp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(icmp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
-        }
+        datagram.header.layer_4_type = PackedRecord::ICMP;
+        find_payload(datagram, *icmp_p, raw_p);
     }
 
     // ICMPv6?
@@ -107,25 +422,8 @@ bool Parser::parse(Tins::PDU &pdu)
     if (icmpv6_p != nullptr)
     {
         datagram.layer_4_type = pdutype_to_string(icmpv6_p->pdu_type());
-
-        if (datagram.payload_type == "")
-        {
-            if (icmpv6_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(icmpv6_p->pdu_type());
-                datagram.payload_size = std::to_string(icmpv6_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(icmpv6_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(icmpv6_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
-        }
+        datagram.header.layer_4_type = PackedRecord::ICMPv6;
+        find_payload(datagram, *icmpv6_p, raw_p);
     }
 
     // IPv4?
@@ -135,25 +433,12 @@ bool Parser::parse(Tins::PDU &pdu)
         datagram.layer_3_type = pdutype_to_string(ip_p->pdu_type());
         datagram.layer_3_src_addr = ip_p->src_addr().to_string();
         datagram.layer_3_dst_addr = ip_p->dst_addr().to_string();
-
-        if (datagram.payload_type == "")
-        {
-            if (ip_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(ip_p->pdu_type());
-                datagram.payload_size = std::to_string(ip_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(ip_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(ip_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
-        }
+        datagram.header.layer_3_type = PackedRecord::IP;
+        const uint32_t src_addr = ip_p->src_addr();
+        const uint32_t dst_addr = ip_p->dst_addr();
+        std::memcpy(datagram.header.layer_3_src_addr, &src_addr, 4);
+        std::memcpy(datagram.header.layer_3_dst_addr, &dst_addr, 4);
+        find_payload(datagram, *ip_p, raw_p);
     }
 
     // IPv6?
@@ -163,50 +448,28 @@ bool Parser::parse(Tins::PDU &pdu)
         datagram.layer_3_type = pdutype_to_string(ipv6_p->pdu_type());
         datagram.layer_3_src_addr = ipv6_p->src_addr().to_string();
         datagram.layer_3_dst_addr = ipv6_p->dst_addr().to_string();
-
-        if (datagram.payload_type == "")
-        {
-            if (ipv6_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(ipv6_p->pdu_type());
-                datagram.payload_size = std::to_string(ipv6_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(ipv6_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(ipv6_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
-        }
+        datagram.header.layer_3_type = PackedRecord::IPv6;
+        const Tins::IPv6Address src_addr = ipv6_p->src_addr();
+        const Tins::IPv6Address dst_addr = ipv6_p->dst_addr();
+        std::copy(src_addr.begin(), src_addr.end(), datagram.header.layer_3_src_addr);
+        std::copy(dst_addr.begin(), dst_addr.end(), datagram.header.layer_3_dst_addr);
+        find_payload(datagram, *ipv6_p, raw_p);
     }
 
+    return tcp_p;
+}
+
+bool Parser::fill_layer_2(datagram_t &datagram, const Tins::PDU &pdu, const Tins::RawPDU *&raw_p, bool with_payload)
+{
     // ARP?
     const Tins::ARP *arp_p = pdu.find_pdu<Tins::ARP>();
     if (arp_p != nullptr)
     {
         datagram.layer_2_type = pdutype_to_string(arp_p->pdu_type());
-
-        if (datagram.payload_type == "")
+        datagram.header.layer_2_type = PackedRecord::ARP;
+        if (with_payload)
         {
-            if (arp_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(arp_p->pdu_type());
-                datagram.payload_size = std::to_string(arp_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(arp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(arp_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
+            find_payload(datagram, *arp_p, raw_p);
         }
     }
 
@@ -217,43 +480,57 @@ bool Parser::parse(Tins::PDU &pdu)
         datagram.layer_2_type = pdutype_to_string(ethernet_p->pdu_type());
         datagram.layer_2_src_addr = ethernet_p->src_addr().to_string();
         datagram.layer_2_dst_addr = ethernet_p->dst_addr().to_string();
-
-        if (datagram.payload_type == "")
+        datagram.header.layer_2_type = PackedRecord::ETHERNET_II;
+        const Tins::EthernetII::address_type src_addr = ethernet_p->src_addr();
+        const Tins::EthernetII::address_type dst_addr = ethernet_p->dst_addr();
+        std::copy(src_addr.begin(), src_addr.end(), datagram.header.layer_2_src_addr);
+        std::copy(dst_addr.begin(), dst_addr.end(), datagram.header.layer_2_dst_addr);
+        if (with_payload)
         {
-            if (ethernet_p->find_pdu<Tins::RawPDU>() != nullptr)
-            {
-                datagram.payload_type = pdutype_to_string(ethernet_p->pdu_type());
-                datagram.payload_size = std::to_string(ethernet_p->find_pdu<Tins::RawPDU>()->payload_size());
-                if (_this->config.payload_convert_method == "hex")
-                {
-                    datagram.payload_encoding_type = "hex";
-                    datagram.payload = uint8_vector_to_hex_string(ethernet_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-                else
-                {
-                    datagram.payload_encoding_type = "base64";
-                    datagram.payload = uint8_vector_to_base64_string(ethernet_p->find_pdu<Tins::RawPDU>()->payload());
-                }
-            }
+            find_payload(datagram, *ethernet_p, raw_p);
         }
     }
 
-    _this->safe_queue->push(datagram);
+    return arp_p != nullptr || ethernet_p != nullptr;
+}
 
-    std::cout << datagram.layer_2_type << " "
-              << datagram.layer_2_src_addr << " -> "
-              << datagram.layer_2_dst_addr << ", "
-              << datagram.layer_3_type << " "
-              << datagram.layer_3_src_addr << " -> "
-              << datagram.layer_3_dst_addr << ", "
-              << datagram.layer_4_type << " "
-              << datagram.layer_4_src_port << " -> "
-              << datagram.layer_4_dst_port << " (Payload: "
-              << datagram.payload_type << ", "
-              << datagram.payload_size << " bytes)"
-              << std::endl;
+void Parser::find_payload(datagram_t &datagram, const Tins::PDU &layer, const Tins::RawPDU *&raw_p)
+{
+    if (raw_p != nullptr)
+    {
+        return;
+    }
+    raw_p = layer.find_pdu<Tins::RawPDU>();
+    if (raw_p != nullptr)
+    {
+        datagram.payload_type = pdutype_to_string(layer.pdu_type());
+        datagram.header.payload_type = pdutype_to_record_type(layer.pdu_type());
+    }
+}
 
-    return true;
+uint8_t Parser::pdutype_to_record_type(const Tins::PDU::PDUType p)
+{
+    switch (p)
+    {
+    case Tins::PDU::PDUType::ETHERNET_II:
+        return PackedRecord::ETHERNET_II;
+    case Tins::PDU::PDUType::ARP:
+        return PackedRecord::ARP;
+    case Tins::PDU::PDUType::IP:
+        return PackedRecord::IP;
+    case Tins::PDU::PDUType::IPv6:
+        return PackedRecord::IPv6;
+    case Tins::PDU::PDUType::TCP:
+        return PackedRecord::TCP;
+    case Tins::PDU::PDUType::UDP:
+        return PackedRecord::UDP;
+    case Tins::PDU::PDUType::ICMP:
+        return PackedRecord::ICMP;
+    case Tins::PDU::PDUType::ICMPv6:
+        return PackedRecord::ICMPv6;
+    default:
+        return PackedRecord::OTHER;
+    }
 }
 
 std::string Parser::pdutype_to_string(const Tins::PDU::PDUType p)
@@ -373,32 +650,33 @@ std::string Parser::pdutype_to_string(const Tins::PDU::PDUType p)
     }
 }
 
-std::string Parser::uint8_vector_to_hex_string(const std::vector<uint8_t> &v)
+std::string Parser::uint8_array_to_hex_string(const uint8_t *v, size_t size)
 {
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
-    std::vector<uint8_t>::const_iterator it;
+    static const char table[] = "0123456789abcdef";
+    std::string cdst(size * 2, '\0');
 
-    for (it = v.begin(); it != v.end(); it++)
+    for (std::size_t i = 0; i < size; ++i)
     {
-        ss << std::setw(2) << static_cast<unsigned>(*it);
+        cdst[i * 2] = table[v[i] >> 4];
+        cdst[i * 2 + 1] = table[v[i] & 0x0F];
     }
 
-    return ss.str();
+    return cdst;
 }
 
-std::string Parser::uint8_vector_to_base64_string(const std::vector<uint8_t> &v)
+std::string Parser::uint8_array_to_base64_string(const uint8_t *v, size_t size)
 {
     const std::string table("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
     std::string cdst;
+    cdst.reserve((size + 2) / 3 * 4);
 
-    for (std::size_t i = 0; i < v.size(); ++i)
+    for (std::size_t i = 0; i < size; ++i)
     {
         switch (i % 3)
         {
         case 0:
             cdst.push_back(table[(v[i] & 0xFC) >> 2]);
-            if (i + 1 == v.size())
+            if (i + 1 == size)
             {
                 cdst.push_back(table[(v[i] & 0x03) << 4]);
                 cdst.push_back('=');
@@ -408,7 +686,7 @@ std::string Parser::uint8_vector_to_base64_string(const std::vector<uint8_t> &v)
             break;
         case 1:
             cdst.push_back(table[((v[i - 1] & 0x03) << 4) | ((v[i + 0] & 0xF0) >> 4)]);
-            if (i + 1 == v.size())
+            if (i + 1 == size)
             {
                 cdst.push_back(table[(v[i] & 0x0F) << 2]);
                 cdst.push_back('=');
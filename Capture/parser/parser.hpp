@@ -3,8 +3,17 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <tins/tins.h>
-#include "safe-queue.hpp"
+#include "batch-queue.hpp"
+#include "packed-record.hpp"
+#include "payload-compressor.hpp"
+#include "tcp-reassembler.hpp"
+#include "ip-defragmenter.hpp"
+#include "decapsulator.hpp"
+#include "flow-table.hpp"
+#include "sampler.hpp"
+#include "sip-tracker.hpp"
 
 class Parser
 {
@@ -12,6 +21,21 @@ public:
     typedef struct Config
     {
         std::string payload_convert_method = "base64";
+        std::string record_format = "fields";
+        // fill Datagram::record with record_format "fields" as well, for sinks that store it
+        bool build_record = false;
+        // stream keys: <stream_prefix><address> or <stream_prefix><default_stream>,
+        // with "call" <stream_prefix><Call-ID> for SIP calls and their media
+        std::string divide_streams = "ip";
+        std::string stream_prefix = "stream/";
+        std::string default_stream = "default";
+        PayloadCompressor::config_t compression;
+        TcpReassembler::config_t tcp_reassembly;
+        IpDefragmenter::config_t ip_defragment;
+        Decapsulator::config_t decapsulation;
+        FlowTable::config_t flows;
+        Sampler::config_t sampling;
+        SipTracker::config_t sip;
     } config_t;
 
     typedef struct Datagram
@@ -32,17 +56,82 @@ public:
         std::string payload_size = "";
         std::string payload_encoding_type;
         std::string payload = "";
+        // method the payload was compressed with, empty if compression is disabled
+        std::string payload_compression = "";
+
+        // encapsulation, comma separated and outermost first, empty if
+        // decapsulation is disabled or the packet was not encapsulated
+        std::string vlan_ids = "";
+        std::string mpls_labels = "";
+        std::string tunnel_type = "";
+        // one position per tunnel_type, empty for tunnels without an id
+        std::string tunnel_id = "";
+
+        // SIP call tracking, empty if it is disabled: media_type is sip,
+        // rtp or rtcp for signalling and negotiated media, the call fields
+        // come from the SIP message or the call the media belongs to
+        std::string media_type = "";
+        std::string call_id = "";
+        std::string sip_from = "";
+        std::string sip_to = "";
+        // SipTracker::media_kind of the datagram
+        uint8_t media = SipTracker::UNTRACKED;
+
+        // numeric copy of the fields above
+        PackedRecord::header_t header;
+        // header and raw payload, with record_format "packed" or build_record
+        std::string record = "";
+
+        // streams the datagram is added to, second_stream_key may be empty
+        std::string stream_key = "";
+        std::string second_stream_key = "";
+        // set on the second copy of a datagram whose stream keys belong to
+        // different writers, for sinks that must see every datagram once
+        bool copy = false;
+        // set on the original of such a datagram: it keeps second_stream_key,
+        // but the copy's writer adds it to that stream
+        bool second_stream_copied = false;
+
+        // steady clock when the datagram was queued, for enqueue-to-ack latency
+        uint64_t enqueued_usec = 0;
     } datagram_t;
 
-    Parser(config_t &c, SafeQueue<datagram_t> *s);
-    static bool parse(Tins::PDU &pdu);
+    // `flow_queue` receives flow records, required if flows are enabled
+    Parser(config_t &c, BatchQueue<datagram_t> *s, BatchQueue<FlowTable::record_t> *flow_queue = nullptr);
+    // one queue per writer, a stream is always routed to the same queue
+    Parser(config_t &c, const std::vector<BatchQueue<datagram_t> *> &s, BatchQueue<FlowTable::record_t> *flow_queue = nullptr);
+    static bool parse(Tins::Packet &packet);
+    // exports pending flows, at the end of a capture file
+    void flush();
+    // exports flows that timed out by `now_usec` [us since epoch], so a
+    // live capture on a quiet link still reports them. parser thread only.
+    void expire(uint64_t now_usec);
+    // packets dropped by sampling, may be read from any thread
+    uint64_t sampled_out() const;
 
 private:
     config_t config;
-    SafeQueue<datagram_t> *safe_queue;
+    std::vector<BatchQueue<datagram_t> *> queues;
+    std::string default_stream_key;
+    std::unique_ptr<PayloadCompressor> compressor;
+    std::vector<uint8_t> compression_buffer;
+    std::unique_ptr<IpDefragmenter> defragmenter;
+    std::unique_ptr<TcpReassembler> reassembler;
+    std::vector<uint8_t> reassembly_buffer;
+    std::unique_ptr<Decapsulator> decapsulator;
+    std::vector<std::unique_ptr<Tins::PDU>> tunneled_pdus;
+    std::unique_ptr<FlowTable> flow_table;
+    std::unique_ptr<Sampler> sampler;
+    std::unique_ptr<SipTracker> sip_tracker;
+    static const Tins::TCP *fill_layer_3_4(datagram_t &datagram, const Tins::PDU &pdu, const Tins::RawPDU *&raw_p);
+    static bool fill_layer_2(datagram_t &datagram, const Tins::PDU &pdu, const Tins::RawPDU *&raw_p, bool with_payload = true);
+    void assign_stream_keys(datagram_t &datagram) const;
+    void route(datagram_t &&datagram);
+    static void find_payload(datagram_t &datagram, const Tins::PDU &layer, const Tins::RawPDU *&raw_p);
     static std::string pdutype_to_string(const Tins::PDU::PDUType p);
-    static std::string uint8_vector_to_base64_string(const std::vector<uint8_t> &v);
-    static std::string uint8_vector_to_hex_string(const std::vector<uint8_t> &v);
+    static uint8_t pdutype_to_record_type(const Tins::PDU::PDUType p);
+    static std::string uint8_array_to_base64_string(const uint8_t *v, size_t size);
+    static std::string uint8_array_to_hex_string(const uint8_t *v, size_t size);
     static uint16_t uint8_vector_to_uint16(const std::vector<uint8_t> &v, int i);
     static uint32_t uint8_vector_to_uint32(const std::vector<uint8_t> &v, int i);
     static Parser *thisPtr;
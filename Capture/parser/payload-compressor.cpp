@@ -0,0 +1,200 @@
+#include "payload-compressor.hpp"
+#include "packed-record.hpp"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sstream>
+
+#ifdef BASIN_WITH_LZ4
+#define LZ4_STATIC_LINKING_ONLY
+#include <lz4.h>
+#endif
+
+#ifdef BASIN_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+PayloadCompressor::PayloadCompressor(const config_t &c)
+{
+    config = c;
+    lz4_stream = nullptr;
+    lz4_dictionary_stream = nullptr;
+    zstd_context = nullptr;
+    zstd_dictionary = nullptr;
+
+    if (config.method == "none")
+    {
+        return;
+    }
+
+    if (!config.ports.empty())
+    {
+        port_selected.assign(65536, false);
+        for (const auto port : config.ports)
+        {
+            port_selected[port] = true;
+        }
+    }
+
+    if (config.dictionary_path != "")
+    {
+        std::ifstream ifs(config.dictionary_path, std::ios::binary);
+        if (!ifs)
+        {
+            throw std::runtime_error("cannot read compression dictionary: " + config.dictionary_path);
+        }
+        dictionary.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+
+    if (config.method == "lz4")
+    {
+#ifdef BASIN_WITH_LZ4
+        lz4_stream = LZ4_createStream();
+        if (!dictionary.empty())
+        {
+            lz4_dictionary_stream = LZ4_createStream();
+            LZ4_loadDict((LZ4_stream_t *)lz4_dictionary_stream, dictionary.data(), (int)dictionary.size());
+        }
+#else
+        throw std::runtime_error("payload compression lz4 is not built in");
+#endif
+    }
+    else if (config.method == "zstd")
+    {
+#ifdef BASIN_WITH_ZSTD
+        zstd_context = ZSTD_createCCtx();
+        int level = config.level == 0 ? 3 : config.level;
+        if (!dictionary.empty())
+        {
+            zstd_dictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+        }
+        else
+        {
+            ZSTD_CCtx_setParameter((ZSTD_CCtx *)zstd_context, ZSTD_c_compressionLevel, level);
+        }
+#else
+        throw std::runtime_error("payload compression zstd is not built in");
+#endif
+    }
+    else
+    {
+        throw std::runtime_error("unknown payload compression: " + config.method);
+    }
+}
+
+PayloadCompressor::~PayloadCompressor()
+{
+#ifdef BASIN_WITH_LZ4
+    if (lz4_stream != nullptr)
+    {
+        LZ4_freeStream((LZ4_stream_t *)lz4_stream);
+    }
+    if (lz4_dictionary_stream != nullptr)
+    {
+        LZ4_freeStream((LZ4_stream_t *)lz4_dictionary_stream);
+    }
+#endif
+#ifdef BASIN_WITH_ZSTD
+    if (zstd_dictionary != nullptr)
+    {
+        ZSTD_freeCDict((ZSTD_CDict *)zstd_dictionary);
+    }
+    if (zstd_context != nullptr)
+    {
+        ZSTD_freeCCtx((ZSTD_CCtx *)zstd_context);
+    }
+#endif
+}
+
+bool PayloadCompressor::enabled() const
+{
+    return config.method != "none";
+}
+
+bool PayloadCompressor::selects(uint16_t sport, uint16_t dport) const
+{
+    return port_selected.empty() || port_selected[sport] || port_selected[dport];
+}
+
+bool PayloadCompressor::compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+{
+    if (size < config.min_size)
+    {
+        return false;
+    }
+
+    size_t compressed_size = 0;
+
+#ifdef BASIN_WITH_LZ4
+    if (lz4_stream != nullptr)
+    {
+        LZ4_stream_t *stream = (LZ4_stream_t *)lz4_stream;
+        out.resize(LZ4_compressBound((int)size));
+        LZ4_resetStream_fast(stream);
+        if (lz4_dictionary_stream != nullptr)
+        {
+            LZ4_attach_dictionary(stream, (const LZ4_stream_t *)lz4_dictionary_stream);
+        }
+        int acceleration = config.level <= 0 ? 1 : config.level;
+        int n = LZ4_compress_fast_continue(stream, (const char *)data, (char *)out.data(), (int)size, (int)out.size(), acceleration);
+        compressed_size = n > 0 ? (size_t)n : 0;
+    }
+#endif
+#ifdef BASIN_WITH_ZSTD
+    if (zstd_context != nullptr)
+    {
+        ZSTD_CCtx *context = (ZSTD_CCtx *)zstd_context;
+        out.resize(ZSTD_compressBound(size));
+        size_t n = zstd_dictionary != nullptr
+                       ? ZSTD_compress_usingCDict(context, out.data(), out.size(), data, size, (const ZSTD_CDict *)zstd_dictionary)
+                       : ZSTD_compress2(context, out.data(), out.size(), data, size);
+        compressed_size = ZSTD_isError(n) ? 0 : n;
+    }
+#endif
+
+    if (compressed_size == 0 || compressed_size >= size)
+    {
+        return false;
+    }
+    out.resize(compressed_size);
+    return true;
+}
+
+const std::string &PayloadCompressor::method() const
+{
+    return config.method;
+}
+
+uint8_t PayloadCompressor::record_compression() const
+{
+    if (config.method == "lz4")
+    {
+        return PackedRecord::LZ4;
+    }
+    if (config.method == "zstd")
+    {
+        return PackedRecord::ZSTD;
+    }
+    return PackedRecord::UNCOMPRESSED;
+}
+
+std::vector<uint16_t> PayloadCompressor::parse_ports(const std::string &s)
+{
+    std::vector<uint16_t> ports;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item == "")
+        {
+            continue;
+        }
+        int port = std::stoi(item);
+        if (port < 0 || port > 65535)
+        {
+            throw std::out_of_range("port out of range: " + item);
+        }
+        ports.push_back((uint16_t)port);
+    }
+    return ports;
+}
@@ -0,0 +1,58 @@
+#ifndef INCLUDE_GUARD_PAYLOAD_COMPRESSOR_HPP
+#define INCLUDE_GUARD_PAYLOAD_COMPRESSOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// optional payload compression, run by the parser before encoding.
+// lz4 and zstd are available when the library was found at build time
+// (BASIN_WITH_LZ4 / BASIN_WITH_ZSTD). both accept a pre-trained dictionary,
+// for example one built with `zstd --train` from captured SIP or HTTP
+// payloads; consumers need the same dictionary to decompress.
+// not thread safe, each parser owns one.
+class PayloadCompressor
+{
+public:
+    typedef struct Config
+    {
+        std::string method = "none";
+        // compress only datagrams from or to these ports, all if empty
+        std::vector<uint16_t> ports;
+        std::string dictionary_path = "";
+        int level = 0;
+        // smaller payloads are stored as is
+        size_t min_size = 64;
+    } config_t;
+
+    // throws std::runtime_error if the method is not built in or the
+    // dictionary cannot be loaded.
+    explicit PayloadCompressor(const config_t &c);
+    ~PayloadCompressor();
+    PayloadCompressor(PayloadCompressor const &) = delete;
+    PayloadCompressor &operator=(PayloadCompressor const &) = delete;
+
+    bool enabled() const;
+    bool selects(uint16_t sport, uint16_t dport) const;
+
+    // compresses into `out`. returns false, leaving `out` unspecified, when
+    // the payload is too small or does not shrink.
+    bool compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+    const std::string &method() const;
+    // PackedRecord::compression value of the method
+    uint8_t record_compression() const;
+
+    static std::vector<uint16_t> parse_ports(const std::string &s);
+
+private:
+    config_t config;
+    std::vector<bool> port_selected;
+    std::vector<char> dictionary;
+    void *lz4_stream;
+    void *lz4_dictionary_stream;
+    void *zstd_context;
+    void *zstd_dictionary;
+};
+
+#endif // INCLUDE_GUARD_PAYLOAD_COMPRESSOR_HPP
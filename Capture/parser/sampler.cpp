@@ -0,0 +1,121 @@
+#include "sampler.hpp"
+#include "flow-key.hpp"
+
+namespace
+{
+    uint64_t fnv1a(const uint8_t *p, size_t size, uint64_t h = 14695981039346656037ULL)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+}
+
+Sampler::Sampler(const config_t &c)
+{
+    config = c;
+    if (config.packet_rate == 0)
+    {
+        config.packet_rate = 1;
+    }
+    if (config.flow_rate == 0)
+    {
+        config.flow_rate = 1;
+    }
+    if (config.rate_burst <= 0)
+    {
+        config.rate_burst = config.rate_limit;
+    }
+    packets = 0;
+    dropped = 0;
+}
+
+bool Sampler::enabled() const
+{
+    return config.packet_rate > 1 || config.flow_rate > 1 || config.rate_limit > 0;
+}
+
+bool Sampler::keep(const PackedRecord::header_t &header, const std::string &call_id)
+{
+    bool kept = true;
+    if (config.packet_rate > 1 && packets++ % config.packet_rate != 0)
+    {
+        kept = false;
+    }
+    else if (config.flow_rate > 1 && flow_key_t::from_header(header).hash() % config.flow_rate != 0)
+    {
+        kept = false;
+    }
+    else if (config.rate_limit > 0 && !take_token(header, call_id))
+    {
+        kept = false;
+    }
+
+    if (!kept)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return kept;
+}
+
+uint64_t Sampler::sampled_out() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+bool Sampler::take_token(const PackedRecord::header_t &header, const std::string &call_id)
+{
+    const uint64_t id = stream_id(header, call_id);
+    auto it = buckets.find(id);
+    if (it == buckets.end())
+    {
+        if (buckets.size() >= config.max_buckets)
+        {
+            buckets.clear();
+        }
+        bucket_t bucket;
+        bucket.tokens = config.rate_burst;
+        bucket.updated_usec = header.timestamp_usec;
+        it = buckets.emplace(id, bucket).first;
+    }
+
+    // refill for the capture time passed since the last packet of the stream
+    bucket_t &bucket = it->second;
+    if (header.timestamp_usec > bucket.updated_usec)
+    {
+        bucket.tokens += (header.timestamp_usec - bucket.updated_usec) * config.rate_limit / 1000000.0;
+        if (bucket.tokens > config.rate_burst)
+        {
+            bucket.tokens = config.rate_burst;
+        }
+        bucket.updated_usec = header.timestamp_usec;
+    }
+    if (bucket.tokens < 1)
+    {
+        return false;
+    }
+    bucket.tokens -= 1;
+    return true;
+}
+
+// destination address or call in the divide mode of the writer, all packets share
+// one stream otherwise
+uint64_t Sampler::stream_id(const PackedRecord::header_t &header, const std::string &call_id) const
+{
+    if (config.divide_streams == "call" && !call_id.empty())
+    {
+        return fnv1a((const uint8_t *)call_id.data(), call_id.size());
+    }
+    if (config.divide_streams == "mac" && header.layer_2_type == PackedRecord::ETHERNET_II)
+    {
+        return fnv1a(header.layer_2_dst_addr, sizeof(header.layer_2_dst_addr));
+    }
+    if (config.divide_streams == "ip" && header.layer_3_type != PackedRecord::NONE)
+    {
+        return fnv1a(header.layer_3_dst_addr, sizeof(header.layer_3_dst_addr));
+    }
+    return 0;
+}
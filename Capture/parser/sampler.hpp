@@ -0,0 +1,63 @@
+#ifndef INCLUDE_GUARD_SAMPLER_HPP
+#define INCLUDE_GUARD_SAMPLER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "packed-record.hpp"
+
+// decides before encoding whether a packet becomes a stream entry, so an
+// overloaded capture drops work instead of growing the queue. modes can be
+// combined, a packet is kept only if every enabled mode keeps it:
+//   packet_rate  keeps every N-th packet
+//   flow_rate    keeps all packets of 1 in N flows, chosen by flow hash,
+//                so the same flows are kept across runs and hosts
+//   rate_limit   token bucket of packets per second per destination stream
+// not thread safe except for the counters, each parser owns one.
+class Sampler
+{
+public:
+    typedef struct Config
+    {
+        // 1 keeps every packet
+        uint32_t packet_rate = 1;
+        uint32_t flow_rate = 1;
+        // packets per second, 0 for no limit
+        double rate_limit = 0;
+        // bucket size, rate_limit if 0
+        double rate_burst = 0;
+        // how entries are divided into streams: none, mac, ip or call
+        std::string divide_streams = "none";
+        // destination streams with a bucket, all are reset beyond this
+        size_t max_buckets = 65536;
+    } config_t;
+
+    explicit Sampler(const config_t &c);
+    Sampler(Sampler const &) = delete;
+    Sampler &operator=(Sampler const &) = delete;
+
+    bool enabled() const;
+    // `call_id` of the datagram, for divide_streams "call"
+    bool keep(const PackedRecord::header_t &header, const std::string &call_id = "");
+
+    // packets sampled out so far, may be read from any thread
+    uint64_t sampled_out() const;
+
+private:
+    typedef struct Bucket
+    {
+        double tokens = 0;
+        uint64_t updated_usec = 0;
+    } bucket_t;
+
+    config_t config;
+    uint64_t packets;
+    std::unordered_map<uint64_t, bucket_t> buckets;
+    std::atomic<uint64_t> dropped;
+
+    bool take_token(const PackedRecord::header_t &header, const std::string &call_id);
+    uint64_t stream_id(const PackedRecord::header_t &header, const std::string &call_id) const;
+};
+
+#endif // INCLUDE_GUARD_SAMPLER_HPP
@@ -0,0 +1,326 @@
+#include "sip-message.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+#include "packed-record.hpp"
+
+namespace
+{
+    // `line` without the line break, false if no complete line is left
+    bool next_line(std::string_view text, size_t &pos, std::string_view &line)
+    {
+        const size_t end = text.find('\n', pos);
+        if (end == std::string_view::npos)
+        {
+            return false;
+        }
+        line = text.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        pos = end + 1;
+        return true;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        {
+            s.remove_suffix(1);
+        }
+        return s;
+    }
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool istarts_with(std::string_view s, std::string_view prefix)
+    {
+        return s.size() >= prefix.size() && iequals(s.substr(0, prefix.size()), prefix);
+    }
+
+    // leading decimal digits, -1 if there are none or too many
+    long parse_number(std::string_view s)
+    {
+        long n = 0;
+        size_t i = 0;
+        for (; i < s.size() && i < 10 && s[i] >= '0' && s[i] <= '9'; i++)
+        {
+            n = n * 10 + (s[i] - '0');
+        }
+        return i == 0 || (i < s.size() && s[i] >= '0' && s[i] <= '9') ? -1 : n;
+    }
+
+    std::string_view next_token(std::string_view s, size_t &pos)
+    {
+        while (pos < s.size() && s[pos] == ' ')
+        {
+            pos++;
+        }
+        const size_t begin = pos;
+        while (pos < s.size() && s[pos] != ' ')
+        {
+            pos++;
+        }
+        return s.substr(begin, pos - begin);
+    }
+}
+
+bool SipMessage::parse(const uint8_t *data, size_t size)
+{
+    clear();
+    const std::string_view text((const char *)data, size);
+    size_t pos = 0;
+    std::string_view line;
+    if (!next_line(text, pos, line))
+    {
+        return false;
+    }
+    if (line.substr(0, 8) == "SIP/2.0 ")
+    {
+        const long code = parse_number(line.substr(8, 3));
+        if (code < 100 || code > 699)
+        {
+            return false;
+        }
+        status = (int)code;
+    }
+    else
+    {
+        // METHOD SP Request-URI SP SIP/2.0
+        const size_t space = line.find(' ');
+        if (space == 0 || space == std::string_view::npos || line.size() < space + 9 ||
+            line.substr(line.size() - 8) != " SIP/2.0")
+        {
+            return false;
+        }
+        for (size_t i = 0; i < space; i++)
+        {
+            if (line[i] < 'A' || line[i] > 'Z')
+            {
+                return false;
+            }
+        }
+        request = true;
+        method = line.substr(0, space);
+    }
+
+    long content_length = -1;
+    bool sdp = false;
+    bool headers_complete = false;
+    while (next_line(text, pos, line))
+    {
+        if (line.empty())
+        {
+            headers_complete = true;
+            break;
+        }
+        const size_t colon = line.find(':');
+        if (line[0] == ' ' || line[0] == '\t' || colon == std::string_view::npos)
+        {
+            continue;
+        }
+        const std::string_view name = trim(line.substr(0, colon));
+        const std::string_view value = trim(line.substr(colon + 1));
+        if (iequals(name, "Call-ID") || iequals(name, "i"))
+        {
+            call_id = value;
+        }
+        else if (iequals(name, "From") || iequals(name, "f"))
+        {
+            from = value;
+        }
+        else if (iequals(name, "To") || iequals(name, "t"))
+        {
+            to = value;
+        }
+        else if (iequals(name, "CSeq") && !request)
+        {
+            size_t p = 0;
+            next_token(value, p);
+            method = next_token(value, p);
+        }
+        else if (iequals(name, "Content-Length") || iequals(name, "l"))
+        {
+            content_length = parse_number(value);
+        }
+        else if (iequals(name, "Content-Type") || iequals(name, "c"))
+        {
+            sdp = istarts_with(value, "application/sdp");
+        }
+    }
+    if (call_id.empty())
+    {
+        return false;
+    }
+    if (headers_complete && sdp)
+    {
+        std::string_view body = text.substr(pos);
+        if (content_length >= 0 && (size_t)content_length < body.size())
+        {
+            body = body.substr(0, (size_t)content_length);
+        }
+        parse_sdp(body);
+    }
+    return true;
+}
+
+void SipMessage::clear()
+{
+    request = false;
+    method.clear();
+    status = 0;
+    call_id.clear();
+    from.clear();
+    to.clear();
+    media.clear();
+}
+
+void SipMessage::parse_sdp(std::string_view body)
+{
+    media_t session;
+    bool session_address = false;
+    media_t current;
+    bool in_media = false;
+    bool current_valid = false;
+    bool current_address = false;
+
+    auto end_media = [&] {
+        if (in_media && current_valid && (current_address || session_address))
+        {
+            if (!current_address)
+            {
+                current.layer_3_type = session.layer_3_type;
+                std::memcpy(current.addr, session.addr, 16);
+            }
+            media.push_back(current);
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < body.size())
+    {
+        std::string_view line;
+        if (!next_line(body, pos, line))
+        {
+            // last line without a line break
+            line = body.substr(pos);
+            pos = body.size();
+        }
+        if (line.size() < 2 || line[1] != '=')
+        {
+            continue;
+        }
+        const std::string_view value = line.substr(2);
+        switch (line[0])
+        {
+        case 'm':
+        {
+            // m=<media> <port>[/<count>] <proto> <fmt> ...
+            end_media();
+            in_media = true;
+            current = media_t();
+            current_address = false;
+            size_t p = 0;
+            next_token(value, p);
+            const std::string_view port = next_token(value, p);
+            const std::string_view proto = next_token(value, p);
+            const long rtp_port = parse_number(port.substr(0, port.find('/')));
+            current_valid = rtp_port > 0 && rtp_port < 65535 && proto.find("RTP") != std::string_view::npos;
+            if (current_valid)
+            {
+                current.rtp_port = (uint16_t)rtp_port;
+                current.rtcp_port = (uint16_t)(rtp_port + 1);
+            }
+            break;
+        }
+        case 'c':
+            if (in_media)
+            {
+                current_address = parse_address(value, current.layer_3_type, current.addr);
+            }
+            else
+            {
+                session_address = parse_address(value, session.layer_3_type, session.addr);
+            }
+            break;
+        case 'a':
+            if (in_media && value == "rtcp-mux")
+            {
+                current.rtcp_port = current.rtp_port;
+            }
+            else if (in_media && value.substr(0, 5) == "rtcp:")
+            {
+                const long rtcp_port = parse_number(value.substr(5));
+                if (rtcp_port > 0 && rtcp_port <= 65535)
+                {
+                    current.rtcp_port = (uint16_t)rtcp_port;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    end_media();
+}
+
+// c=IN IP4 <address>[/<ttl>] or c=IN IP6 <address>. the unspecified
+// address of a call on hold is not an endpoint.
+bool SipMessage::parse_address(std::string_view connection, uint8_t &layer_3_type, uint8_t *addr)
+{
+    size_t p = 0;
+    const std::string_view network = next_token(connection, p);
+    const std::string_view type = next_token(connection, p);
+    std::string_view address = next_token(connection, p);
+    address = address.substr(0, address.find('/'));
+    if (network != "IN" || address.empty() || address.size() >= INET6_ADDRSTRLEN)
+    {
+        return false;
+    }
+    char text[INET6_ADDRSTRLEN];
+    std::memcpy(text, address.data(), address.size());
+    text[address.size()] = '\0';
+
+    uint8_t parsed[16] = {};
+    if (type == "IP4" && inet_pton(AF_INET, text, parsed) == 1)
+    {
+        if (std::memcmp(parsed, "\0\0\0\0", 4) == 0)
+        {
+            return false;
+        }
+        layer_3_type = PackedRecord::IP;
+    }
+    else if (type == "IP6" && inet_pton(AF_INET6, text, parsed) == 1)
+    {
+        static const uint8_t unspecified[16] = {};
+        if (std::memcmp(parsed, unspecified, 16) == 0)
+        {
+            return false;
+        }
+        layer_3_type = PackedRecord::IPv6;
+    }
+    else
+    {
+        return false;
+    }
+    std::memcpy(addr, parsed, 16);
+    return true;
+}
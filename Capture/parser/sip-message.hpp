@@ -0,0 +1,47 @@
+#ifndef INCLUDE_GUARD_SIP_MESSAGE_HPP
+#define INCLUDE_GUARD_SIP_MESSAGE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the parts of a SIP message (RFC 3261) needed to follow calls: start line,
+// Call-ID, From, To, CSeq and the RTP media of an SDP body (RFC 4566).
+// compact header names are understood, header folding is not.
+class SipMessage
+{
+public:
+    typedef struct Media
+    {
+        // PackedRecord::IP or IPv6, address as in PackedRecord::header_t
+        uint8_t layer_3_type = 0;
+        uint8_t addr[16] = {};
+        uint16_t rtp_port = 0;
+        // rtp_port + 1 unless a=rtcp or a=rtcp-mux says otherwise
+        uint16_t rtcp_port = 0;
+    } media_t;
+
+    bool request = false;
+    // of a request, or of the CSeq of a response
+    std::string method;
+    int status = 0;
+    std::string call_id;
+    std::string from;
+    std::string to;
+    // RTP media lines with a port and a connection address
+    std::vector<media_t> media;
+
+    // returns false if `data` does not start with a SIP start line or has
+    // no Call-ID. a body cut off by the end of `data` is parsed as far as
+    // it goes.
+    bool parse(const uint8_t *data, size_t size);
+
+private:
+    void clear();
+    void parse_sdp(std::string_view body);
+    static bool parse_address(std::string_view connection, uint8_t &layer_3_type, uint8_t *addr);
+};
+
+#endif // INCLUDE_GUARD_SIP_MESSAGE_HPP
@@ -0,0 +1,217 @@
+#include "sip-tracker.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint64_t usec_per_sec = 1000000;
+    // media still arriving after the BYE is kept with the call
+    const uint64_t ended_linger_usec = 2 * usec_per_sec;
+
+    // RTCP packet types 192..223 take the place of the RTP marker and payload type
+    bool is_rtcp(const uint8_t *payload, size_t size)
+    {
+        return size >= 2 && (payload[0] & 0xc0) == 0x80 && payload[1] >= 192 && payload[1] <= 223;
+    }
+}
+
+bool SipTracker::Endpoint::operator==(const Endpoint &other) const
+{
+    return port == other.port && std::memcmp(addr, other.addr, sizeof(addr)) == 0;
+}
+
+size_t SipTracker::EndpointHash::operator()(const endpoint_t &endpoint) const
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (uint8_t b : endpoint.addr)
+    {
+        h ^= b;
+        h *= 1099511628211ULL;
+    }
+    h ^= endpoint.port;
+    h *= 1099511628211ULL;
+    return (size_t)h;
+}
+
+SipTracker::SipTracker(const config_t &c)
+{
+    config = c;
+    next_sweep_usec = 0;
+}
+
+SipTracker::media_kind SipTracker::process(const PackedRecord::header_t &header, const uint8_t *payload, size_t size,
+                                           const call_t *&call)
+{
+    call = nullptr;
+    if (header.timestamp_usec >= next_sweep_usec)
+    {
+        sweep(header.timestamp_usec);
+        next_sweep_usec = header.timestamp_usec + usec_per_sec;
+    }
+
+    const bool udp = header.layer_4_type == PackedRecord::UDP;
+    if (!udp && header.layer_4_type != PackedRecord::TCP)
+    {
+        return OTHER;
+    }
+    if ((is_sip_port(header.layer_4_src_port) || is_sip_port(header.layer_4_dst_port)) &&
+        payload != nullptr && message.parse(payload, size))
+    {
+        call = signalling(header.timestamp_usec);
+        return SIGNALLING;
+    }
+    if (!udp || endpoints.empty())
+    {
+        return OTHER;
+    }
+
+    // media is sent to the negotiated endpoint, or from it with symmetric RTP
+    endpoint_t endpoint;
+    std::memcpy(endpoint.addr, header.layer_3_dst_addr, sizeof(endpoint.addr));
+    endpoint.port = header.layer_4_dst_port;
+    auto it = endpoints.find(endpoint);
+    if (it == endpoints.end())
+    {
+        std::memcpy(endpoint.addr, header.layer_3_src_addr, sizeof(endpoint.addr));
+        endpoint.port = header.layer_4_src_port;
+        it = endpoints.find(endpoint);
+        if (it == endpoints.end())
+        {
+            return OTHER;
+        }
+    }
+    media_t &media = it->second;
+    if (media.expires_usec < header.timestamp_usec)
+    {
+        return OTHER;
+    }
+    // the endpoints of an ended call keep their short expiry
+    if (!media.call->endpoints.empty())
+    {
+        media.expires_usec = header.timestamp_usec + (uint64_t)config.media_timeout_sec * usec_per_sec;
+    }
+    call = &media.call->call;
+    if (media.kind == RTP && is_rtcp(payload, payload != nullptr ? size : 0))
+    {
+        // RTCP multiplexed on the RTP port (RFC 5761)
+        return RTCP;
+    }
+    return media.kind;
+}
+
+bool SipTracker::is_sip_port(uint16_t port) const
+{
+    return std::find(config.ports.begin(), config.ports.end(), port) != config.ports.end();
+}
+
+const SipTracker::call_t *SipTracker::signalling(uint64_t timestamp_usec)
+{
+    std::shared_ptr<call_state_t> state;
+    auto it = calls.find(message.call_id);
+    if (it != calls.end())
+    {
+        state = it->second.lock();
+    }
+
+    const bool ends = message.request && (message.method == "BYE" || message.method == "CANCEL");
+    if (state && ends)
+    {
+        end_call(*state, timestamp_usec + ended_linger_usec);
+    }
+    if (!message.media.empty() && !ends)
+    {
+        if (!state)
+        {
+            state = std::make_shared<call_state_t>();
+            state->call.call_id = message.call_id;
+            state->call.from = message.from;
+            state->call.to = message.to;
+            calls[message.call_id] = state;
+        }
+        const uint64_t expires_usec = timestamp_usec + (uint64_t)config.media_timeout_sec * usec_per_sec;
+        for (const SipMessage::media_t &media : message.media)
+        {
+            learn(state, media.addr, media.rtp_port, RTP, expires_usec);
+            if (media.rtcp_port != media.rtp_port)
+            {
+                learn(state, media.addr, media.rtcp_port, RTCP, expires_usec);
+            }
+        }
+    }
+    // only the media table keeps calls alive. a new call whose endpoints
+    // did not fit ends with `state`, its fields are copied instead.
+    if (state && state.use_count() > 1)
+    {
+        return &state->call;
+    }
+
+    signalling_call.call_id = message.call_id;
+    signalling_call.from = message.from;
+    signalling_call.to = message.to;
+    return &signalling_call;
+}
+
+void SipTracker::learn(const std::shared_ptr<call_state_t> &call, const uint8_t *addr, uint16_t port,
+                       media_kind kind, uint64_t expires_usec)
+{
+    endpoint_t endpoint;
+    std::memcpy(endpoint.addr, addr, sizeof(endpoint.addr));
+    endpoint.port = port;
+    auto it = endpoints.find(endpoint);
+    if (it == endpoints.end())
+    {
+        if (endpoints.size() >= config.max_endpoints)
+        {
+            return;
+        }
+        it = endpoints.emplace(endpoint, media_t()).first;
+    }
+    // a port reused by another call moves to it
+    media_t &media = it->second;
+    media.call = call;
+    media.kind = kind;
+    media.expires_usec = expires_usec;
+    if (std::find(call->endpoints.begin(), call->endpoints.end(), endpoint) == call->endpoints.end())
+    {
+        call->endpoints.push_back(endpoint);
+    }
+}
+
+void SipTracker::end_call(call_state_t &call, uint64_t expires_usec)
+{
+    for (const endpoint_t &endpoint : call.endpoints)
+    {
+        auto it = endpoints.find(endpoint);
+        if (it != endpoints.end() && it->second.call.get() == &call)
+        {
+            it->second.expires_usec = std::min(it->second.expires_usec, expires_usec);
+        }
+    }
+    call.endpoints.clear();
+}
+
+void SipTracker::sweep(uint64_t timestamp_usec)
+{
+    for (auto it = endpoints.begin(); it != endpoints.end();)
+    {
+        if (it->second.expires_usec < timestamp_usec)
+        {
+            it = endpoints.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    for (auto it = calls.begin(); it != calls.end();)
+    {
+        if (it->second.expired())
+        {
+            it = calls.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef INCLUDE_GUARD_SIP_TRACKER_HPP
+#define INCLUDE_GUARD_SIP_TRACKER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "packed-record.hpp"
+#include "sip-message.hpp"
+
+// follows SIP calls on the signalling ports and learns their RTP and RTCP
+// endpoints from the SDP offers and answers, so UDP packets can be told
+// apart as negotiated media of a call. an endpoint expires media_timeout_sec
+// after its last packet, or shortly after the BYE or CANCEL of its call.
+// SIP over TCP is parsed per segment, before flow selection and TCP
+// reassembly. lookups and updates happen in the parser thread only, sinks
+// see the result through the datagram. not thread safe, each parser owns one.
+class SipTracker
+{
+public:
+    enum media_kind : uint8_t
+    {
+        // tracking is disabled
+        UNTRACKED = 0,
+        SIGNALLING = 1,
+        RTP = 2,
+        RTCP = 3,
+        // neither SIP nor media of a known call
+        OTHER = 4,
+    };
+
+    typedef struct Config
+    {
+        bool enabled = false;
+        // UDP and TCP ports carrying SIP
+        std::vector<uint16_t> ports = {5060};
+        // endpoints followed at once, further media is not learned
+        size_t max_endpoints = 65536;
+        int media_timeout_sec = 60;
+    } config_t;
+
+    typedef struct Call
+    {
+        std::string call_id;
+        std::string from;
+        std::string to;
+    } call_t;
+
+    explicit SipTracker(const config_t &c);
+    SipTracker(SipTracker const &) = delete;
+    SipTracker &operator=(SipTracker const &) = delete;
+
+    // `call` is set for signalling and media of a known call, and stays
+    // valid until the next call to process()
+    media_kind process(const PackedRecord::header_t &header, const uint8_t *payload, size_t size,
+                       const call_t *&call);
+
+private:
+    typedef struct Endpoint
+    {
+        uint8_t addr[16] = {};
+        uint16_t port = 0;
+
+        bool operator==(const Endpoint &other) const;
+    } endpoint_t;
+
+    struct EndpointHash
+    {
+        size_t operator()(const endpoint_t &endpoint) const;
+    };
+
+    typedef struct CallState
+    {
+        call_t call;
+        // learned from its SDP bodies, some may have expired
+        std::vector<endpoint_t> endpoints;
+    } call_state_t;
+
+    typedef struct Media
+    {
+        std::shared_ptr<call_state_t> call;
+        media_kind kind = RTP;
+        uint64_t expires_usec = 0;
+    } media_t;
+
+    config_t config;
+    SipMessage message;
+    std::unordered_map<endpoint_t, media_t, EndpointHash> endpoints;
+    std::unordered_map<std::string, std::weak_ptr<call_state_t>> calls;
+    // signalling messages without a known call
+    call_t signalling_call;
+    uint64_t next_sweep_usec;
+
+    bool is_sip_port(uint16_t port) const;
+    const call_t *signalling(uint64_t timestamp_usec);
+    void learn(const std::shared_ptr<call_state_t> &call, const uint8_t *addr, uint16_t port,
+               media_kind kind, uint64_t expires_usec);
+    void end_call(call_state_t &call, uint64_t expires_usec);
+    void sweep(uint64_t timestamp_usec);
+};
+
+#endif // INCLUDE_GUARD_SIP_TRACKER_HPP
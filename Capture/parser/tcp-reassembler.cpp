@@ -0,0 +1,139 @@
+#include "tcp-reassembler.hpp"
+#include <chrono>
+#include <algorithm>
+
+TcpReassembler::TcpReassembler(const config_t &c)
+{
+    config = c;
+    released_p = nullptr;
+
+    follower.stream_keep_alive(std::chrono::seconds(config.idle_timeout_sec));
+    follower.new_stream_callback([this](Tins::TCPIP::Stream &stream) {
+        on_new_stream(stream);
+    });
+    follower.stream_termination_callback([this](Tins::TCPIP::Stream &stream, Tins::TCPIP::StreamFollower::TerminationReason) {
+        on_finished(stream);
+    });
+}
+
+bool TcpReassembler::process(Tins::Packet &packet, const flow_key_t &key, std::vector<uint8_t> &released)
+{
+    released.clear();
+    // a FIN removes the stream while processing, a SYN adds it
+    bool followed = streams.count(key) > 0;
+
+    // libtins keeps every stream it saw the SYN of, even ignored ones, so
+    // the SYNs of streams beyond max_streams never reach it
+    if (!followed)
+    {
+        const Tins::TCP *tcp = packet.pdu()->find_pdu<Tins::TCP>();
+        if (tcp == nullptr || !tcp->get_flag(Tins::TCP::SYN) || tcp->get_flag(Tins::TCP::ACK) ||
+            streams.size() >= config.max_streams)
+        {
+            return false;
+        }
+    }
+
+    released_p = &released;
+    follower.process_packet(packet);
+    released_p = nullptr;
+
+    // libtins has no call to drop a stream, a reset ends it like a real one
+    for (std::unique_ptr<Tins::PDU> &reset : resets)
+    {
+        follower.process_packet(*reset);
+    }
+    resets.clear();
+
+    return followed || streams.count(key) > 0;
+}
+
+void TcpReassembler::on_new_stream(Tins::TCPIP::Stream &stream)
+{
+    streams.insert(stream_key(stream));
+    stream.auto_cleanup_payloads(true);
+    stream.client_data_callback([this](Tins::TCPIP::Stream &s) {
+        on_data(s.client_payload());
+    });
+    stream.server_data_callback([this](Tins::TCPIP::Stream &s) {
+        on_data(s.server_payload());
+    });
+    stream.client_out_of_order_callback([this](Tins::TCPIP::Stream &s, uint32_t, const Tins::TCPIP::Stream::payload_type &) {
+        on_out_of_order(s);
+    });
+    stream.server_out_of_order_callback([this](Tins::TCPIP::Stream &s, uint32_t, const Tins::TCPIP::Stream::payload_type &) {
+        on_out_of_order(s);
+    });
+    stream.stream_closed_callback([this](Tins::TCPIP::Stream &s) {
+        on_finished(s);
+    });
+}
+
+void TcpReassembler::on_out_of_order(Tins::TCPIP::Stream &stream)
+{
+    if (stream.client_flow().total_buffered_bytes() + stream.server_flow().total_buffered_bytes() <= config.max_buffered_bytes)
+    {
+        return;
+    }
+    const flow_key_t key = stream_key(stream);
+    if (streams.erase(key) == 0)
+    {
+        return;
+    }
+    stream.ignore_client_data();
+    stream.ignore_server_data();
+
+    Tins::TCP tcp(stream.server_port(), stream.client_port());
+    tcp.flags(Tins::TCP::RST);
+    tcp.seq(stream.client_flow().sequence_number());
+    if (stream.is_v6())
+    {
+        resets.emplace_back(new Tins::IPv6(Tins::IPv6(stream.server_addr_v6(), stream.client_addr_v6()) / tcp));
+    }
+    else
+    {
+        resets.emplace_back(new Tins::IP(Tins::IP(stream.server_addr_v4(), stream.client_addr_v4()) / tcp));
+    }
+}
+
+void TcpReassembler::on_data(const std::vector<uint8_t> &payload)
+{
+    // data is only released while processing the segment that completes it
+    if (released_p != nullptr)
+    {
+        released_p->insert(released_p->end(), payload.begin(), payload.end());
+    }
+}
+
+void TcpReassembler::on_finished(Tins::TCPIP::Stream &stream)
+{
+    streams.erase(stream_key(stream));
+}
+
+flow_key_t TcpReassembler::stream_key(const Tins::TCPIP::Stream &stream)
+{
+    uint8_t client_addr[16] = {};
+    uint8_t server_addr[16] = {};
+    uint8_t layer_3_type;
+
+    if (stream.is_v6())
+    {
+        const Tins::IPv6Address client = stream.client_addr_v6();
+        const Tins::IPv6Address server = stream.server_addr_v6();
+        std::copy(client.begin(), client.end(), client_addr);
+        std::copy(server.begin(), server.end(), server_addr);
+        layer_3_type = PackedRecord::IPv6;
+    }
+    else
+    {
+        const uint32_t client = stream.client_addr_v4();
+        const uint32_t server = stream.server_addr_v4();
+        std::memcpy(client_addr, &client, 4);
+        std::memcpy(server_addr, &server, 4);
+        layer_3_type = PackedRecord::IP;
+    }
+
+    return flow_key_t::make(layer_3_type, PackedRecord::TCP,
+                            client_addr, stream.client_port(),
+                            server_addr, stream.server_port());
+}
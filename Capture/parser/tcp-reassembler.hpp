@@ -0,0 +1,58 @@
+#ifndef INCLUDE_GUARD_TCP_REASSEMBLER_HPP
+#define INCLUDE_GUARD_TCP_REASSEMBLER_HPP
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <tins/tins.h>
+#include <tins/tcp_ip/stream_follower.h>
+#include "flow-key.hpp"
+
+// follows TCP streams with libtins' StreamFollower and hands back the
+// in-order payload each segment releases. duplicates and retransmissions
+// release nothing. only streams seen from their handshake are followed, and
+// only their segments are shown to libtins, so it holds no other streams.
+// not thread safe, each parser owns one.
+class TcpReassembler
+{
+public:
+    typedef struct Config
+    {
+        bool enabled = false;
+        // streams beyond this are not reassembled, their segments pass through
+        size_t max_streams = 65536;
+        // a stream holding more out of order bytes than this, both directions
+        // together, stops being reassembled and its later segments pass through
+        size_t max_buffered_bytes = 3 * 1024 * 1024;
+        // streams without packets for this long are dropped
+        int idle_timeout_sec = 60;
+    } config_t;
+
+    explicit TcpReassembler(const config_t &c);
+    TcpReassembler(TcpReassembler const &) = delete;
+    TcpReassembler &operator=(TcpReassembler const &) = delete;
+
+    // feeds one TCP packet whose flow is `key`. returns false if the flow is
+    // not followed, then the segment should be emitted as it is. otherwise
+    // `released` holds the payload bytes that became contiguous with this
+    // segment, empty for retransmissions, out of order data and pure ACKs.
+    bool process(Tins::Packet &packet, const flow_key_t &key, std::vector<uint8_t> &released);
+
+private:
+    config_t config;
+    Tins::TCPIP::StreamFollower follower;
+    std::unordered_set<flow_key_t, FlowKeyHash> streams;
+    std::vector<uint8_t> *released_p;
+    // resets ending streams over max_buffered_bytes, fed once the segment
+    // that overflowed them is processed
+    std::vector<std::unique_ptr<Tins::PDU>> resets;
+
+    void on_new_stream(Tins::TCPIP::Stream &stream);
+    void on_data(const std::vector<uint8_t> &payload);
+    void on_out_of_order(Tins::TCPIP::Stream &stream);
+    void on_finished(Tins::TCPIP::Stream &stream);
+    static flow_key_t stream_key(const Tins::TCPIP::Stream &stream);
+};
+
+#endif // INCLUDE_GUARD_TCP_REASSEMBLER_HPP
@@ -0,0 +1,135 @@
+#include "adaptive-batcher.hpp"
+#include <algorithm>
+
+namespace
+{
+    // weight of the latest pipeline in the learned costs
+    const double cost_smoothing = 0.2;
+    // the arrival rate is averaged over about this long, so one burst does
+    // not look like a lasting rate
+    const double rate_time_constant_usec = 1000000;
+    const uint64_t max_idle_wait_usec = 5000;
+    // the round trip budget is at least this multiple of the fixed cost
+    const double min_budget_per_fixed_cost = 2;
+    // a backlog is spread over about this many pipelines, each within this
+    // multiple of the target unless keeping up with arrivals takes longer
+    const size_t backlog_drain_pipelines = 4;
+    const double max_backlog_rtt_per_target = 2;
+    // batch sizes must vary by this much of their mean to separate the
+    // fixed cost from the cost per datagram
+    const double min_relative_spread = 0.05;
+}
+
+AdaptiveBatcher::AdaptiveBatcher(const config_t &c)
+{
+    config = c;
+    if (config.min_batch == 0)
+    {
+        config.min_batch = 1;
+    }
+    if (config.max_batch < config.min_batch)
+    {
+        config.max_batch = config.min_batch;
+    }
+    cost_usec = 0;
+    fixed_usec = 0;
+    mean_n = 0;
+    mean_r = 0;
+    mean_nn = 0;
+    mean_nr = 0;
+    learned = false;
+    last_rtt_usec = 0;
+    arrival_rate = 0;
+    last_backlog = 0;
+    last_batch = 0;
+    last_usec = 0;
+}
+
+size_t AdaptiveBatcher::next_batch_size(size_t backlog, uint64_t now_usec)
+{
+    // datagrams waiting now beyond those left over from the last call arrived since
+    if (last_usec != 0 && now_usec > last_usec)
+    {
+        const size_t remaining = last_backlog > last_batch ? last_backlog - last_batch : 0;
+        const size_t arrived = backlog > remaining ? backlog - remaining : 0;
+        const double elapsed = (double)(now_usec - last_usec);
+        const double rate = arrived / elapsed;
+        arrival_rate += elapsed / (elapsed + rate_time_constant_usec) * (rate - arrival_rate);
+    }
+    last_usec = now_usec;
+    last_backlog = backlog;
+
+    if (!learned)
+    {
+        last_batch = std::min(backlog, config.min_batch);
+        return last_batch;
+    }
+
+    const double budget = std::max((double)config.target_latency_usec / 2, fixed_usec * min_budget_per_fixed_cost);
+    double limit = (budget - fixed_usec) / cost_usec;
+
+    // the backlog waits longer than the target whatever we do: keep up with
+    // the arrivals of one pipeline and take a share of the backlog on top
+    if (fixed_usec + backlog * cost_usec > config.target_latency_usec)
+    {
+        const double keep_up = arrival_rate * last_rtt_usec;
+        const double bounded = (config.target_latency_usec * max_backlog_rtt_per_target - fixed_usec) / cost_usec;
+        limit = std::max(limit, std::min(keep_up + (double)backlog / backlog_drain_pipelines, std::max(bounded, keep_up)));
+    }
+    limit = std::max((double)config.min_batch, std::min((double)config.max_batch, limit));
+    last_batch = std::min(backlog, (size_t)limit);
+    return last_batch;
+}
+
+void AdaptiveBatcher::record(size_t batch_size, uint64_t rtt_usec)
+{
+    if (batch_size == 0)
+    {
+        return;
+    }
+    const double n = (double)batch_size;
+    const double r = (double)rtt_usec;
+    last_rtt_usec = rtt_usec;
+    if (!learned)
+    {
+        // all of the first round trip counts per datagram until batch
+        // sizes vary enough to tell the fixed cost apart
+        mean_n = n;
+        mean_r = r;
+        mean_nn = n * n;
+        mean_nr = n * r;
+        cost_usec = r / n;
+        fixed_usec = 0;
+        learned = true;
+        return;
+    }
+    mean_n += cost_smoothing * (n - mean_n);
+    mean_r += cost_smoothing * (r - mean_r);
+    mean_nn += cost_smoothing * (n * n - mean_nn);
+    mean_nr += cost_smoothing * (n * r - mean_nr);
+
+    const double variance = mean_nn - mean_n * mean_n;
+    if (variance > (min_relative_spread * mean_n) * (min_relative_spread * mean_n))
+    {
+        const double slope = (mean_nr - mean_n * mean_r) / variance;
+        // a noisy fit may say datagrams are free, keep a small cost then
+        cost_usec = std::max(slope, mean_r / mean_n * 0.01);
+        fixed_usec = std::max(0.0, mean_r - cost_usec * mean_n);
+    }
+}
+
+uint64_t AdaptiveBatcher::idle_wait_usec() const
+{
+    // a datagram arriving right after the check waits this long plus one round trip
+    return std::min(max_idle_wait_usec, config.target_latency_usec / 4);
+}
+
+double AdaptiveBatcher::cost_per_datagram_usec() const
+{
+    return cost_usec;
+}
+
+double AdaptiveBatcher::fixed_cost_usec() const
+{
+    return fixed_usec;
+}
@@ -0,0 +1,63 @@
+#ifndef INCLUDE_GUARD_ADAPTIVE_BATCHER_HPP
+#define INCLUDE_GUARD_ADAPTIVE_BATCHER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// picks how many datagrams the writer puts into one pipeline.
+// the round trip of a pipeline is learned as a fixed cost plus a cost per
+// datagram, and a batch is sized so its round trip stays within half of
+// the target enqueue-to-ack latency. a fixed cost close to or above that
+// leaves little room for datagrams, the budget then grows to twice the
+// fixed cost rather than shrinking batches to min_batch.
+// a backlog that cannot be drained within the target anyway is sent in
+// batches that carry what arrived during the last pipeline plus a share
+// of the backlog, so it shrinks over a few bounded pipelines.
+class AdaptiveBatcher
+{
+public:
+    typedef struct Config
+    {
+        uint64_t target_latency_usec = 10000;
+        size_t min_batch = 16;
+        size_t max_batch = 65536;
+    } config_t;
+
+    explicit AdaptiveBatcher(const config_t &c);
+
+    // datagrams to send next out of `backlog` waiting ones, at `now_usec`
+    // on the steady clock. successive backlogs give the arrival rate.
+    size_t next_batch_size(size_t backlog, uint64_t now_usec);
+
+    // round trip of a pipeline carrying `batch_size` datagrams
+    void record(size_t batch_size, uint64_t rtt_usec);
+
+    // how long the writer sleeps when the queue is empty
+    uint64_t idle_wait_usec() const;
+
+    // learned cost of one datagram, 0 before the first pipeline
+    double cost_per_datagram_usec() const;
+
+    // learned fixed cost of a round trip, 0 before the first pipeline
+    double fixed_cost_usec() const;
+
+private:
+    config_t config;
+    double cost_usec;
+    double fixed_usec;
+    // smoothed moments of batch size n and round trip r, for a least
+    // squares fit of r = fixed_usec + cost_usec * n
+    double mean_n;
+    double mean_r;
+    double mean_nn;
+    double mean_nr;
+    bool learned;
+    uint64_t last_rtt_usec;
+    // arrival rate [datagrams/us] from successive backlogs
+    double arrival_rate;
+    size_t last_backlog;
+    size_t last_batch;
+    uint64_t last_usec;
+};
+
+#endif // INCLUDE_GUARD_ADAPTIVE_BATCHER_HPP
@@ -0,0 +1,230 @@
+#include "audio-sink.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include "g711.hpp"
+
+// fields of a frame entry:
+//   ssrc, codec (PCMU or PCMA), layer_3_src_addr, layer_4_src_port,
+//   layer_3_dst_addr, layer_4_dst_port, sample_rate (8000),
+//   format (s16le), frame (index in the stream, from 0),
+//   first_sample_usec (capture time), end (1 in the last frame of the
+//   stream, which may be shorter or empty), samples (binary),
+//   call_id, sip_from, sip_to (only if the stream belongs to a SIP call)
+
+namespace
+{
+    const uint32_t sample_rate = 8000;
+    const uint64_t sample_usec = 1000000 / sample_rate;
+
+    uint64_t steady_sec()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+AudioSink::AudioSink(const config_t &c)
+    : redis(c.redis)
+{
+    config = c;
+    frame_samples = std::max<size_t>(1, (size_t)config.frame_ms * sample_rate / 1000);
+    stream_max_length_str = std::to_string(config.redis.stream_max_length);
+    refused = 0;
+    reported_refused = 0;
+}
+
+const char *AudioSink::name() const
+{
+    return "Audio";
+}
+
+void AudioSink::write(const Parser::datagram_t *datagrams, size_t count,
+                      const FlowTable::record_t *, size_t)
+{
+    const uint64_t now_sec = steady_sec();
+    for (size_t i = 0; i < count; i++)
+    {
+        decode(datagrams[i], now_sec);
+    }
+    send();
+}
+
+void AudioSink::poll()
+{
+    const uint64_t now_sec = steady_sec();
+    for (auto it = streams.begin(); it != streams.end();)
+    {
+        stream_t &stream = *it->second;
+        if (now_sec - stream.last_seen_sec < (uint64_t)config.idle_timeout_sec)
+        {
+            ++it;
+            continue;
+        }
+        stream.jitter.flush([&](const JitterBuffer::packet_t &packet) {
+            append(stream, packet);
+        });
+        emit(stream, true);
+        it = streams.erase(it);
+    }
+
+    if (refused != reported_refused)
+    {
+        std::cout << "Audio: " << refused - reported_refused << " packets of streams beyond "
+                  << config.max_streams << " not decoded" << std::endl;
+        reported_refused = refused;
+    }
+    send();
+}
+
+void AudioSink::decode(const Parser::datagram_t &datagram, uint64_t now_sec)
+{
+    rtp_stream_key_t key;
+    PackedRecord::header_t header;
+    RtpHeader::header_t rtp;
+    if (!RtpStreamKey::from_datagram(datagram, key, header, rtp))
+    {
+        return;
+    }
+    auto it = streams.find(key);
+    if (it == streams.end())
+    {
+        if (rtp.payload_type != RtpHeader::PCMU && rtp.payload_type != RtpHeader::PCMA)
+        {
+            return;
+        }
+        if (streams.size() >= config.max_streams)
+        {
+            refused++;
+            return;
+        }
+        std::unique_ptr<stream_t> stream(new stream_t(config.jitter_packets));
+        stream->payload_type = rtp.payload_type;
+        stream->ssrc = std::to_string(rtp.ssrc);
+        stream->src_addr = datagram.layer_3_src_addr;
+        stream->src_port = datagram.layer_4_src_port;
+        stream->dst_addr = datagram.layer_3_dst_addr;
+        stream->dst_port = datagram.layer_4_dst_port;
+        stream->frame.reserve(frame_samples);
+        it = streams.emplace(key, std::move(stream)).first;
+    }
+
+    stream_t &stream = *it->second;
+    // media may arrive before the SDP answer that ties it to its call
+    if (stream.call_id.empty() && !datagram.call_id.empty())
+    {
+        stream.call_id = datagram.call_id;
+        stream.sip_from = datagram.sip_from;
+        stream.sip_to = datagram.sip_to;
+    }
+    stream.last_seen_sec = now_sec;
+    stream.jitter.push(rtp, header.timestamp_usec, [&](const JitterBuffer::packet_t &packet) {
+        append(stream, packet);
+    });
+}
+
+void AudioSink::append(stream_t &stream, const JitterBuffer::packet_t &packet)
+{
+    // comfort noise, DTMF events: their time becomes silence
+    if (packet.payload_type != stream.payload_type)
+    {
+        return;
+    }
+    size_t fill = 0;
+    size_t skip = 0;
+    if (!stream.timeline.place(packet.timestamp, packet.payload.size(), config.max_gap_sec * sample_rate, fill, skip))
+    {
+        return;
+    }
+    add_samples(stream, nullptr, fill, packet.timestamp_usec - fill * sample_usec);
+    add_samples(stream, packet.payload.data() + skip, packet.payload.size() - skip, packet.timestamp_usec + skip * sample_usec);
+}
+
+void AudioSink::add_samples(stream_t &stream, const uint8_t *payload, size_t samples, uint64_t usec)
+{
+    while (samples > 0)
+    {
+        if (stream.frame.empty())
+        {
+            stream.frame_usec = usec;
+        }
+        const size_t used = stream.frame.size();
+        const size_t n = std::min(samples, frame_samples - used);
+        stream.frame.resize(used + n);
+        if (payload == nullptr)
+        {
+            std::fill(stream.frame.begin() + used, stream.frame.end(), 0);
+        }
+        else if (stream.payload_type == RtpHeader::PCMA)
+        {
+            G711::decode_alaw(payload, n, stream.frame.data() + used);
+            payload += n;
+        }
+        else
+        {
+            G711::decode_ulaw(payload, n, stream.frame.data() + used);
+            payload += n;
+        }
+        samples -= n;
+        usec += n * sample_usec;
+        if (stream.frame.size() == frame_samples)
+        {
+            emit(stream, false);
+        }
+    }
+}
+
+void AudioSink::emit(stream_t &stream, bool end)
+{
+    // while redis is unreachable frames are dropped, decoding goes on
+    if (send_error.empty())
+    {
+        index_str = std::to_string(stream.frame_index);
+        usec_str = std::to_string(stream.frame_usec);
+        // samples in host order, little endian on the platforms capture runs on
+        const std::string_view samples((const char *)stream.frame.data(), stream.frame.size() * sizeof(int16_t));
+        const char *codec = stream.payload_type == RtpHeader::PCMA ? "PCMA" : "PCMU";
+        const char *end_str = end ? "1" : "0";
+        frame_args.clear();
+        frame_args.insert(frame_args.end(), {"XADD", config.stream_key});
+        if (config.redis.stream_max_length > 0)
+        {
+            frame_args.insert(frame_args.end(), {"MAXLEN", "~", stream_max_length_str});
+        }
+        frame_args.insert(frame_args.end(), {"*",
+                                             "ssrc", stream.ssrc, "codec", codec,
+                                             "layer_3_src_addr", stream.src_addr, "layer_4_src_port", stream.src_port,
+                                             "layer_3_dst_addr", stream.dst_addr, "layer_4_dst_port", stream.dst_port,
+                                             "sample_rate", "8000", "format", "s16le",
+                                             "frame", index_str, "first_sample_usec", usec_str,
+                                             "end", end_str, "samples", samples});
+        if (!stream.call_id.empty())
+        {
+            frame_args.insert(frame_args.end(), {"call_id", stream.call_id, "sip_from", stream.sip_from, "sip_to", stream.sip_to});
+        }
+        try
+        {
+            redis.append(config.stream_key, [&](RespEncoder &e) {
+                e.append_command(frame_args.data(), frame_args.size());
+            });
+        }
+        catch (std::runtime_error &e)
+        {
+            send_error = e.what();
+        }
+    }
+    stream.frame.clear();
+    stream.frame_index++;
+}
+
+void AudioSink::send()
+{
+    if (!send_error.empty())
+    {
+        const std::string error = send_error;
+        send_error.clear();
+        throw std::runtime_error(error);
+    }
+    redis.execute(name());
+}
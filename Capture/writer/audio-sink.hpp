@@ -0,0 +1,98 @@
+#ifndef INCLUDE_GUARD_AUDIO_SINK_HPP
+#define INCLUDE_GUARD_AUDIO_SINK_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "sink.hpp"
+#include "rtp-stream.hpp"
+#include "jitter-buffer.hpp"
+#include "redis-sink.hpp"
+#include "redis-pipeline.hpp"
+
+// decodes the G.711 RTP streams of UDP datagrams to 16 bit PCM and adds
+// them to `stream_key` in frames of frame_ms, one XADD per frame instead
+// of one entry per packet. every RTP stream (SSRC and direction) has its
+// own frame sequence, see the field list in audio-sink.cpp. packets are
+// reordered in a JitterBuffer, lost packets and comfort noise become
+// silence. a stream idle for idle_timeout_sec ends with a frame whose
+// "end" field is 1. needs Datagram::record and uncompressed payloads, RTP
+// on compressed ports is not decoded.
+class AudioSink : public Sink
+{
+public:
+    typedef struct Config
+    {
+        uint32_t frame_ms = 160;
+        size_t jitter_packets = 4;
+        int idle_timeout_sec = 5;
+        // streams decoded at once, further streams are skipped
+        size_t max_streams = 1024;
+        // longer timestamp gaps are not filled
+        uint32_t max_gap_sec = 5;
+        // connection; stream_max_length trims the audio stream as well
+        RedisSink::config_t redis;
+        std::string stream_key = "stream/audio";
+    } config_t;
+
+    explicit AudioSink(const config_t &c);
+    AudioSink(AudioSink const &) = delete;
+    AudioSink &operator=(AudioSink const &) = delete;
+
+    const char *name() const override;
+    void write(const Parser::datagram_t *datagrams, size_t count,
+               const FlowTable::record_t *flows, size_t flow_count) override;
+    // ends idle streams
+    void poll() override;
+
+private:
+    typedef struct Stream
+    {
+        JitterBuffer jitter;
+        rtp_timeline_t timeline;
+        uint8_t payload_type = 0;
+        std::string ssrc;
+        std::string src_addr;
+        std::string src_port;
+        std::string dst_addr;
+        std::string dst_port;
+        // SIP call of the stream, empty if it is not tracked
+        std::string call_id;
+        std::string sip_from;
+        std::string sip_to;
+        // samples of the current frame, capture time of its first sample
+        std::vector<int16_t> frame;
+        uint64_t frame_usec = 0;
+        uint64_t frame_index = 0;
+        // steady clock [s] of the last packet
+        uint64_t last_seen_sec = 0;
+
+        explicit Stream(size_t jitter_packets) : jitter(jitter_packets) {}
+    } stream_t;
+
+    config_t config;
+    size_t frame_samples;
+    std::string stream_max_length_str;
+    std::unordered_map<rtp_stream_key_t, std::unique_ptr<stream_t>, RtpStreamKeyHash> streams;
+    uint64_t refused;
+    uint64_t reported_refused;
+    RedisPipeline redis;
+    // first failure to reach redis since the last send()
+    std::string send_error;
+    // fields of the frame being encoded
+    std::string index_str;
+    std::string usec_str;
+    std::vector<std::string_view> frame_args;
+
+    void decode(const Parser::datagram_t &datagram, uint64_t now_sec);
+    void append(stream_t &stream, const JitterBuffer::packet_t &packet);
+    // `samples` decoded samples, or silence if `payload` is null
+    void add_samples(stream_t &stream, const uint8_t *payload, size_t samples, uint64_t usec);
+    void emit(stream_t &stream, bool end);
+    void send();
+};
+
+#endif // INCLUDE_GUARD_AUDIO_SINK_HPP
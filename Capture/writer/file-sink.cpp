@@ -0,0 +1,153 @@
+#include "file-sink.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    const char file_magic[8] = {'B', 'S', 'N', 'F', 'I', 'L', 'E', '1'};
+    // files of a concurrent run are skipped, not overwritten
+    const int max_open_attempts = 100;
+
+    // highest sequence of the <path>-<sequence>.bsn files that exist already
+    unsigned long last_sequence(const std::string &path)
+    {
+        const size_t slash = path.rfind('/');
+        const std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        const std::string prefix = (slash == std::string::npos ? path : path.substr(slash + 1)) + "-";
+        const std::string suffix = ".bsn";
+
+        unsigned long last = 0;
+        DIR *dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return last;
+        }
+        while (const struct dirent *entry = readdir(dir))
+        {
+            const std::string name = entry->d_name;
+            if (name.size() <= prefix.size() + suffix.size() ||
+                name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            {
+                continue;
+            }
+            const std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+            if (digits.size() > 18 || digits.find_first_not_of("0123456789") != std::string::npos)
+            {
+                continue;
+            }
+            last = std::max(last, std::stoul(digits));
+        }
+        closedir(dir);
+        return last;
+    }
+}
+
+FileSink::FileSink(const config_t &c)
+{
+    config = c;
+    file = nullptr;
+    file_size = 0;
+    // a restarted capture continues after the files of earlier runs
+    sequence = last_sequence(config.path);
+}
+
+FileSink::~FileSink()
+{
+    close();
+}
+
+const char *FileSink::name() const
+{
+    return "File";
+}
+
+void FileSink::write(const Parser::datagram_t *datagrams, size_t count,
+                     const FlowTable::record_t *, size_t)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (datagrams[i].copy)
+        {
+            continue;
+        }
+        const size_t size = entry_size(datagrams[i]);
+        if (file == nullptr || (file_size + 4 + size > config.max_file_size && file_size > sizeof(file_magic)))
+        {
+            open_next();
+        }
+
+        buffer.resize(4 + size);
+        buffer[0] = (uint8_t)(size & 0xff);
+        buffer[1] = (uint8_t)((size >> 8) & 0xff);
+        buffer[2] = (uint8_t)((size >> 16) & 0xff);
+        buffer[3] = (uint8_t)((size >> 24) & 0xff);
+        write_entry(buffer.data() + 4, datagrams[i]);
+        if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        {
+            const std::string error = std::strerror(errno);
+            close();
+            throw std::runtime_error("fwrite: " + files.back() + ": " + error);
+        }
+        file_size += buffer.size();
+    }
+
+    // readers see whole batches
+    if (file != nullptr && std::fflush(file) != 0)
+    {
+        const std::string error = std::strerror(errno);
+        close();
+        throw std::runtime_error("fflush: " + files.back() + ": " + error);
+    }
+}
+
+void FileSink::open_next()
+{
+    close();
+
+    // never truncates an existing file
+    std::string path;
+    int fd = -1;
+    for (int attempt = 0; fd < 0; attempt++)
+    {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "-%06lu.bsn", ++sequence);
+        path = config.path + suffix;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && (errno != EEXIST || attempt + 1 >= max_open_attempts))
+        {
+            throw std::runtime_error("open: " + path + ": " + std::strerror(errno));
+        }
+    }
+    file = fdopen(fd, "wb");
+    if (file == nullptr)
+    {
+        const std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("fdopen: " + path + ": " + error);
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1024 * 1024);
+    std::fwrite(file_magic, 1, sizeof(file_magic), file);
+    file_size = sizeof(file_magic);
+
+    files.push_back(path);
+    while (config.max_files > 0 && files.size() > config.max_files)
+    {
+        unlink(files.front().c_str());
+        files.pop_front();
+    }
+}
+
+void FileSink::close()
+{
+    if (file != nullptr)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef INCLUDE_GUARD_FILE_SINK_HPP
+#define INCLUDE_GUARD_FILE_SINK_HPP
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+#include "sink.hpp"
+
+// appends datagrams to local files, rotated by size.
+// files are named <path>-<sequence>.bsn, continuing after the highest
+// sequence present at start, and begin with the 8 byte magic
+// "BSNFILE1", followed by entries of u32 little endian size and a
+// Sink entry. flow records are not stored.
+class FileSink : public Sink
+{
+public:
+    typedef struct Config
+    {
+        std::string path = "capture";
+        size_t max_file_size = 256 * 1024 * 1024;
+        // oldest files of this run are deleted beyond this, 0 keeps all
+        size_t max_files = 0;
+    } config_t;
+
+    explicit FileSink(const config_t &c);
+    ~FileSink();
+    FileSink(FileSink const &) = delete;
+    FileSink &operator=(FileSink const &) = delete;
+
+    const char *name() const override;
+    void write(const Parser::datagram_t *datagrams, size_t count,
+               const FlowTable::record_t *flows, size_t flow_count) override;
+
+private:
+    config_t config;
+    FILE *file;
+    size_t file_size;
+    unsigned long sequence;
+    std::deque<std::string> files;
+    std::vector<uint8_t> buffer;
+
+    void open_next();
+    void close();
+};
+
+#endif // INCLUDE_GUARD_FILE_SINK_HPP
@@ -0,0 +1,183 @@
+#ifndef INCLUDE_GUARD_JITTER_BUFFER_HPP
+#define INCLUDE_GUARD_JITTER_BUFFER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "rtp-header.hpp"
+
+// puts the packets of one RTP stream back into sequence order. in order
+// packets pass straight through, a missing packet holds back at most
+// `depth` packets behind it and is given up when the window is full.
+// the start of a stream is held until the window is full, so a first
+// packet that arrives after the second one is not lost.
+// packets older than the window are dropped as late, jumps beyond
+// max_dropout or max_misorder (RFC 3550 A.1) restart the sequence once
+// a second packet confirms them.
+// slots keep their payload capacity, so steady state does not allocate.
+class JitterBuffer
+{
+public:
+    static const int32_t max_dropout = 3000;
+    static const int32_t max_misorder = 100;
+
+    typedef struct Packet
+    {
+        uint16_t sequence = 0;
+        uint32_t timestamp = 0;
+        uint8_t payload_type = 0;
+        // capture time [us since epoch]
+        uint64_t timestamp_usec = 0;
+        std::vector<uint8_t> payload;
+    } packet_t;
+
+    explicit JitterBuffer(size_t depth)
+        : slots(depth > 0 ? depth : 1), filled(slots.size(), false)
+    {
+    }
+
+    // `release(const packet_t &)` is called for every packet that leaves
+    // the buffer, in sequence order
+    template <typename F>
+    void push(const RtpHeader::header_t &rtp, uint64_t timestamp_usec, F &&release)
+    {
+        const int32_t depth = (int32_t)slots.size();
+        if (!started)
+        {
+            restart(rtp.sequence);
+        }
+        int32_t distance = (int16_t)(uint16_t)(rtp.sequence - next);
+        if (holding && distance < 0 && top - distance < depth)
+        {
+            // nothing is released yet, the stream starts with this packet
+            head = (head + slots.size() - (size_t)-distance) % slots.size();
+            next = rtp.sequence;
+            top -= distance;
+            distance = 0;
+        }
+        else if (distance < 0 && distance >= -max_misorder)
+        {
+            late_count++;
+            return;
+        }
+        else if (distance < 0 || distance >= max_dropout)
+        {
+            // a single stray packet does not restart the stream, the next
+            // one has to follow it
+            if (!jumped || rtp.sequence != jump_sequence)
+            {
+                jumped = true;
+                jump_sequence = (uint16_t)(rtp.sequence + 1);
+                late_count++;
+                return;
+            }
+            flush(release);
+            restart(rtp.sequence);
+            distance = 0;
+        }
+        jumped = false;
+        if (distance >= depth)
+        {
+            // give up the oldest packets until this one fits
+            const int32_t advance = distance - depth + 1;
+            for (int32_t i = 0; i < advance && i < depth; i++)
+            {
+                release_head(release);
+            }
+            if (advance > depth)
+            {
+                // the window is empty now, skip the rest of the gap at once
+                lost_count += (uint64_t)(advance - depth);
+                next = (uint16_t)(next + (advance - depth));
+            }
+            distance = depth - 1;
+        }
+
+        const size_t index = (head + (size_t)distance) % slots.size();
+        if (filled[index])
+        {
+            duplicate_count++;
+            return;
+        }
+        packet_t &slot = slots[index];
+        slot.sequence = rtp.sequence;
+        slot.timestamp = rtp.timestamp;
+        slot.payload_type = rtp.payload_type;
+        slot.timestamp_usec = timestamp_usec;
+        slot.payload.assign(rtp.payload, rtp.payload + rtp.payload_size);
+        filled[index] = true;
+        buffered++;
+        if (holding)
+        {
+            top = std::max(top, distance);
+            return;
+        }
+
+        while (buffered > 0 && filled[head])
+        {
+            release_head(release);
+        }
+    }
+
+    // releases every buffered packet, missing ones are counted as lost
+    template <typename F>
+    void flush(F &&release)
+    {
+        while (buffered > 0)
+        {
+            release_head(release);
+        }
+    }
+
+    // packets given up, arriving after the window had moved on, or twice
+    uint64_t lost() const { return lost_count; }
+    uint64_t late() const { return late_count; }
+    uint64_t duplicates() const { return duplicate_count; }
+
+private:
+    std::vector<packet_t> slots;
+    std::vector<bool> filled;
+    // slot of sequence number `next`
+    size_t head = 0;
+    uint16_t next = 0;
+    bool started = false;
+    // nothing released since the start, `top` is the largest distance buffered
+    bool holding = false;
+    int32_t top = 0;
+    // a jump was seen, sequence number expected to confirm it
+    bool jumped = false;
+    uint16_t jump_sequence = 0;
+    size_t buffered = 0;
+    uint64_t lost_count = 0;
+    uint64_t late_count = 0;
+    uint64_t duplicate_count = 0;
+
+    void restart(uint16_t sequence)
+    {
+        next = sequence;
+        started = true;
+        holding = true;
+        top = 0;
+    }
+
+    template <typename F>
+    void release_head(F &&release)
+    {
+        holding = false;
+        if (filled[head])
+        {
+            release(slots[head]);
+            filled[head] = false;
+            buffered--;
+        }
+        else
+        {
+            lost_count++;
+        }
+        head = (head + 1) % slots.size();
+        next++;
+    }
+};
+
+#endif // INCLUDE_GUARD_JITTER_BUFFER_HPP
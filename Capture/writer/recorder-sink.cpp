@@ -0,0 +1,310 @@
+#include "recorder-sink.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    uint64_t steady_sec()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // streams with the same name, e.g. a restarted sender within one
+    // second, get a numbered file each
+    const int max_name_attempts = 1000;
+
+    // G.711 code of a zero sample
+    uint8_t silence(uint8_t payload_type)
+    {
+        return payload_type == RtpHeader::PCMA ? 0xd5 : 0xff;
+    }
+
+    bool exists(const std::string &path)
+    {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+}
+
+RecorderSink::RecorderSink(const config_t &c)
+    : redis(c.redis)
+{
+    config = c;
+    refused = 0;
+    reported_refused = 0;
+    if (mkdir(config.path.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        throw std::runtime_error("mkdir: " + config.path + ": " + std::strerror(errno));
+    }
+}
+
+RecorderSink::~RecorderSink()
+{
+    for (auto &entry : recordings)
+    {
+        try
+        {
+            finish(*entry.second);
+        }
+        catch (std::runtime_error &e)
+        {
+            std::cout << "Recorder error: " << e.what() << std::endl;
+        }
+    }
+    try
+    {
+        announce();
+    }
+    catch (std::runtime_error &e)
+    {
+        std::cout << "Recorder error: " << e.what() << std::endl;
+    }
+}
+
+const char *RecorderSink::name() const
+{
+    return "Recorder";
+}
+
+void RecorderSink::write(const Parser::datagram_t *datagrams, size_t count,
+                         const FlowTable::record_t *, size_t)
+{
+    const uint64_t now_sec = steady_sec();
+    // a failing file should not cost the other streams their packets
+    std::string error;
+    for (size_t i = 0; i < count; i++)
+    {
+        try
+        {
+            record(datagrams[i], now_sec);
+        }
+        catch (std::runtime_error &e)
+        {
+            error = e.what();
+        }
+    }
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+void RecorderSink::poll()
+{
+    const uint64_t now_sec = steady_sec();
+    std::string error;
+    for (auto it = recordings.begin(); it != recordings.end();)
+    {
+        if (now_sec - it->second->last_seen_sec < (uint64_t)config.idle_timeout_sec)
+        {
+            ++it;
+            continue;
+        }
+        try
+        {
+            finish(*it->second);
+        }
+        catch (std::runtime_error &e)
+        {
+            error = e.what();
+        }
+        it = recordings.erase(it);
+    }
+
+    if (refused != reported_refused)
+    {
+        std::cout << "Recorder: " << refused - reported_refused << " packets of streams beyond "
+                  << config.max_streams << " not recorded" << std::endl;
+        reported_refused = refused;
+    }
+
+    announce();
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+void RecorderSink::record(const Parser::datagram_t &datagram, uint64_t now_sec)
+{
+    rtp_stream_key_t key;
+    PackedRecord::header_t header;
+    RtpHeader::header_t rtp;
+    if (!RtpStreamKey::from_datagram(datagram, key, header, rtp))
+    {
+        return;
+    }
+    auto it = recordings.find(key);
+    if (it == recordings.end())
+    {
+        if (rtp.payload_type != RtpHeader::PCMU && rtp.payload_type != RtpHeader::PCMA)
+        {
+            return;
+        }
+        if (recordings.size() >= config.max_streams)
+        {
+            refused++;
+            return;
+        }
+
+        std::unique_ptr<recording_t> recording(new recording_t(config.jitter_packets));
+        recording->payload_type = rtp.payload_type;
+        recording->ssrc = rtp.ssrc;
+        recording->src_addr = datagram.layer_3_src_addr;
+        recording->src_port = datagram.layer_4_src_port;
+        recording->dst_addr = datagram.layer_3_dst_addr;
+        recording->dst_port = datagram.layer_4_dst_port;
+        recording->first_usec = header.timestamp_usec;
+
+        const time_t start = (time_t)(header.timestamp_usec / 1000000);
+        struct tm tm;
+        gmtime_r(&start, &tm);
+        char name[96];
+        std::strftime(name, sizeof(name), "%Y%m%d-%H%M%S", &tm);
+        char ssrc[16];
+        std::snprintf(ssrc, sizeof(ssrc), "%08x", rtp.ssrc);
+        const std::string base = config.path + "/" + name + "-" +
+                                 recording->src_addr + "-" + recording->src_port + "-" +
+                                 recording->dst_addr + "-" + recording->dst_port + "-" + ssrc;
+        // WavFile never replaces a file, a name taken meanwhile fails like
+        // any other open and the next packet tries again
+        recording->path = base + ".wav";
+        for (int n = 1; exists(recording->path) || exists(recording->path + ".part"); n++)
+        {
+            if (n >= max_name_attempts)
+            {
+                throw std::runtime_error("no free name for " + base + ".wav");
+            }
+            recording->path = base + "-" + std::to_string(n) + ".wav";
+        }
+        recording->file.reset(new WavFile(recording->path + ".part",
+                                          rtp.payload_type == RtpHeader::PCMA ? WavFile::ALAW : WavFile::MULAW,
+                                          8000, config.file));
+        it = recordings.emplace(key, std::move(recording)).first;
+    }
+
+    recording_t &recording = *it->second;
+    recording.last_seen_sec = now_sec;
+    recording.last_usec = header.timestamp_usec;
+    try
+    {
+        recording.jitter.push(rtp, header.timestamp_usec, [&](const JitterBuffer::packet_t &packet) {
+            append(recording, packet);
+        });
+    }
+    catch (std::runtime_error &e)
+    {
+        // the file is given up, the next packet starts a new one
+        unlink((recording.path + ".part").c_str());
+        recordings.erase(it);
+        throw;
+    }
+}
+
+void RecorderSink::append(recording_t &recording, const JitterBuffer::packet_t &packet)
+{
+    // comfort noise, DTMF events: their time becomes silence
+    if (packet.payload_type != recording.payload_type)
+    {
+        return;
+    }
+
+    // G.711 is one byte per sample at 8000 Hz
+    size_t fill = 0;
+    size_t skip = 0;
+    if (!recording.timeline.place(packet.timestamp, packet.payload.size(), config.max_gap_sec * 8000, fill, skip))
+    {
+        return;
+    }
+    if (fill > 0)
+    {
+        recording.file->fill(silence(recording.payload_type), fill);
+        recording.filled_samples += fill;
+    }
+    recording.file->write(packet.payload.data() + skip, packet.payload.size() - skip);
+    recording.packets++;
+}
+
+void RecorderSink::finish(recording_t &recording)
+{
+    const std::string part = recording.path + ".part";
+    try
+    {
+        recording.jitter.flush([&](const JitterBuffer::packet_t &packet) {
+            append(recording, packet);
+        });
+        recording.file->close();
+    }
+    catch (std::runtime_error &e)
+    {
+        unlink(part.c_str());
+        throw;
+    }
+    if (recording.packets < config.min_packets)
+    {
+        unlink(part.c_str());
+        return;
+    }
+    if (rename(part.c_str(), recording.path.c_str()) != 0)
+    {
+        throw std::runtime_error("rename: " + part + ": " + std::strerror(errno));
+    }
+
+    announcement_t a;
+    a.path = recording.path;
+    a.ssrc = std::to_string(recording.ssrc);
+    a.codec = recording.payload_type == RtpHeader::PCMA ? "PCMA" : "PCMU";
+    a.src_addr = recording.src_addr;
+    a.src_port = recording.src_port;
+    a.dst_addr = recording.dst_addr;
+    a.dst_port = recording.dst_port;
+    a.start_usec = std::to_string(recording.first_usec);
+    a.duration_ms = std::to_string(recording.file->data_size() / 8);
+    a.packets = std::to_string(recording.packets);
+    a.lost = std::to_string(recording.jitter.lost());
+    a.late = std::to_string(recording.jitter.late());
+    announcements.push_back(std::move(a));
+    if (announcements.size() > max_announcements)
+    {
+        announcements.pop_front();
+    }
+}
+
+void RecorderSink::announce()
+{
+    if (announcements.empty())
+    {
+        return;
+    }
+    const std::string &key = config.stream_key;
+    auto encode = [&](RespEncoder &e, const announcement_t &a) {
+        e.append_command({"XADD", key, "*",
+                          "path", a.path,
+                          "ssrc", a.ssrc,
+                          "codec", a.codec,
+                          "layer_3_src_addr", a.src_addr,
+                          "layer_4_src_port", a.src_port,
+                          "layer_3_dst_addr", a.dst_addr,
+                          "layer_4_dst_port", a.dst_port,
+                          "first_seen_usec", a.start_usec,
+                          "duration_ms", a.duration_ms,
+                          "packets", a.packets,
+                          "packets_lost", a.lost,
+                          "packets_late", a.late});
+    };
+
+    // on failure the announcements are sent again with the next poll()
+    for (const announcement_t &a : announcements)
+    {
+        redis.append(key, [&](RespEncoder &e) { encode(e, a); });
+    }
+    redis.execute(name());
+    announcements.clear();
+}
@@ -0,0 +1,118 @@
+#ifndef INCLUDE_GUARD_RECORDER_SINK_HPP
+#define INCLUDE_GUARD_RECORDER_SINK_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "sink.hpp"
+#include "rtp-stream.hpp"
+#include "jitter-buffer.hpp"
+#include "wav-file.hpp"
+#include "redis-sink.hpp"
+#include "redis-pipeline.hpp"
+
+// records the G.711 RTP streams of UDP datagrams to WAV files, one file per
+// SSRC and flow direction. packets are reordered in a JitterBuffer, gaps in
+// the RTP timestamps are filled with silence, packets of other payload
+// types (comfort noise, DTMF events) are skipped. a stream that has been
+// idle for idle_timeout_sec is finished and announced with one XADD to
+// `stream_key`; packets themselves cause no redis traffic.
+// needs Datagram::record and uncompressed payloads, RTP on compressed ports
+// is not recorded.
+class RecorderSink : public Sink
+{
+public:
+    typedef struct Config
+    {
+        // directory of the recordings, files are named
+        // <start time>-<src addr>-<src port>-<dst addr>-<dst port>-<ssrc>.wav,
+        // with -<n> before .wav if that exists already, and carry a .part
+        // suffix until they are finished
+        std::string path = "recordings";
+        size_t jitter_packets = 8;
+        int idle_timeout_sec = 10;
+        // streams recorded at once, further streams are not recorded
+        size_t max_streams = 1024;
+        // shorter streams are deleted without announcement, mostly UDP
+        // traffic that only looked like RTP
+        uint64_t min_packets = 10;
+        // longer timestamp gaps, e.g. a restarted sender, are not filled
+        uint32_t max_gap_sec = 60;
+        WavFile::config_t file;
+        // connection of the announcements, flow_stream_key is not used
+        RedisSink::config_t redis;
+        std::string stream_key = "stream/recordings";
+    } config_t;
+
+    explicit RecorderSink(const config_t &c);
+    // finishes every open recording
+    ~RecorderSink();
+    RecorderSink(RecorderSink const &) = delete;
+    RecorderSink &operator=(RecorderSink const &) = delete;
+
+    const char *name() const override;
+    void write(const Parser::datagram_t *datagrams, size_t count,
+               const FlowTable::record_t *flows, size_t flow_count) override;
+    // finishes idle recordings and sends pending announcements
+    void poll() override;
+
+private:
+    typedef struct Recording
+    {
+        std::string path;
+        std::unique_ptr<WavFile> file;
+        JitterBuffer jitter;
+        uint8_t payload_type = 0;
+        uint32_t ssrc = 0;
+        std::string src_addr;
+        std::string src_port;
+        std::string dst_addr;
+        std::string dst_port;
+        // capture time [us since epoch]
+        uint64_t first_usec = 0;
+        uint64_t last_usec = 0;
+        // steady clock [s] of the last packet
+        uint64_t last_seen_sec = 0;
+        rtp_timeline_t timeline;
+        uint64_t packets = 0;
+        uint64_t filled_samples = 0;
+
+        explicit Recording(size_t jitter_packets) : jitter(jitter_packets) {}
+    } recording_t;
+
+    config_t config;
+    std::unordered_map<rtp_stream_key_t, std::unique_ptr<recording_t>, RtpStreamKeyHash> recordings;
+    uint64_t refused;
+    uint64_t reported_refused;
+
+    // fields of the XADD of a finished recording
+    typedef struct Announcement
+    {
+        std::string path;
+        std::string ssrc;
+        std::string codec;
+        std::string src_addr;
+        std::string src_port;
+        std::string dst_addr;
+        std::string dst_port;
+        std::string start_usec;
+        std::string duration_ms;
+        std::string packets;
+        std::string lost;
+        std::string late;
+    } announcement_t;
+
+    // kept while redis is unreachable, the oldest are dropped beyond max_announcements
+    static const size_t max_announcements = 10000;
+    std::deque<announcement_t> announcements;
+    RedisPipeline redis;
+
+    void record(const Parser::datagram_t &datagram, uint64_t now_sec);
+    void append(recording_t &recording, const JitterBuffer::packet_t &packet);
+    void finish(recording_t &recording);
+    void announce();
+};
+
+#endif // INCLUDE_GUARD_RECORDER_SINK_HPP
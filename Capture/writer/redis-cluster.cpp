@@ -0,0 +1,262 @@
+#include "redis-cluster.hpp"
+#include <stdexcept>
+#include <cstring>
+
+namespace
+{
+    const int max_redirects = 5;
+
+    struct Crc16Table
+    {
+        uint16_t entries[256];
+
+        Crc16Table()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                uint16_t crc = (uint16_t)(i << 8);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+                }
+                entries[i] = crc;
+            }
+        }
+    };
+
+    // CRC16-CCITT (XMODEM), as in the redis cluster specification
+    uint16_t crc16(const char *data, size_t size)
+    {
+        static const Crc16Table table;
+        uint16_t crc = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = (uint16_t)((crc << 8) ^ table.entries[((crc >> 8) ^ (uint8_t)data[i]) & 0xff]);
+        }
+        return crc;
+    }
+}
+
+RedisCluster::RedisCluster()
+{
+    socket_buffer_size = 0;
+}
+
+void RedisCluster::connect(const std::string &hostname, const std::string &port)
+{
+    close();
+    seed_hostname = hostname;
+
+    RedisConnection seed;
+    seed.set_socket_buffer_size(socket_buffer_size);
+    seed.connect(hostname, port);
+    load_slots(seed);
+
+    for (auto &node : nodes)
+    {
+        node->connection.connect(node->hostname, node->port);
+    }
+}
+
+void RedisCluster::close()
+{
+    nodes.clear();
+    slot_nodes.clear();
+    redirects.clear();
+}
+
+void RedisCluster::set_socket_buffer_size(int bytes)
+{
+    socket_buffer_size = bytes;
+    for (auto &node : nodes)
+    {
+        node->connection.set_socket_buffer_size(bytes);
+    }
+}
+
+bool RedisCluster::is_connected() const
+{
+    return !nodes.empty();
+}
+
+uint16_t RedisCluster::key_slot(std::string_view key)
+{
+    // only the part between the first { and the next } is hashed, if not empty
+    const size_t open = key.find('{');
+    if (open != std::string_view::npos)
+    {
+        const size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close != open + 1)
+        {
+            key = key.substr(open + 1, close - open - 1);
+        }
+    }
+    return crc16(key.data(), key.size()) % slot_count;
+}
+
+void RedisCluster::execute(const std::function<void(const std::string &)> &on_error)
+{
+    for (int round = 0; round <= max_redirects; round++)
+    {
+        bool pending = false;
+        for (auto &node : nodes)
+        {
+            if (!node->commands.empty())
+            {
+                if (!node->connection.is_connected())
+                {
+                    node->connection.connect(node->hostname, node->port);
+                }
+                node->connection.send(node->encoder);
+                pending = true;
+            }
+        }
+        if (!pending)
+        {
+            return;
+        }
+
+        // a redirect to a new node appends to nodes, so iterate by index
+        redirects.clear();
+        const size_t node_count = nodes.size();
+        for (size_t i = 0; i < node_count; i++)
+        {
+            node_t *node = nodes[i].get();
+            for (const command_t &command : node->commands)
+            {
+                node->connection.read_reply(reply);
+                if (!reply.is_error())
+                {
+                    continue;
+                }
+                redirect_t redirect;
+                if (parse_redirect(reply.str, redirect.node, redirect.asking))
+                {
+                    redirect.command.assign(node->encoder.data() + command.begin, command.end - command.begin);
+                    redirects.push_back(std::move(redirect));
+                }
+                else
+                {
+                    on_error(reply.str);
+                }
+            }
+            node->encoder.clear();
+            node->commands.clear();
+        }
+
+        if (round == max_redirects && !redirects.empty())
+        {
+            on_error("too many redirects, " + std::to_string(redirects.size()) + " commands dropped");
+            return;
+        }
+        for (const redirect_t &redirect : redirects)
+        {
+            node_t &node = *nodes[redirect.node];
+            if (redirect.asking)
+            {
+                const size_t begin = node.encoder.size();
+                node.encoder.append_command({"ASKING"});
+                node.commands.push_back(command_t{begin, node.encoder.size()});
+            }
+            const size_t begin = node.encoder.size();
+            node.encoder.append_raw(redirect.command.data(), redirect.command.size());
+            node.commands.push_back(command_t{begin, node.encoder.size()});
+        }
+    }
+}
+
+size_t RedisCluster::size() const
+{
+    return nodes.size();
+}
+
+void RedisCluster::load_slots(RedisConnection &connection)
+{
+    RespEncoder encoder;
+    encoder.append_command({"CLUSTER", "SLOTS"});
+    connection.send(encoder);
+    connection.read_reply(reply);
+    if (reply.is_error())
+    {
+        throw std::runtime_error("CLUSTER SLOTS: " + reply.str);
+    }
+
+    // each entry: start, end, primary [host, port, id], replicas...
+    const RedisConnection::reply_t slots = reply;
+    slot_nodes.assign(slot_count, 0);
+    std::vector<bool> covered(slot_count, false);
+    for (const auto &entry : slots.elements)
+    {
+        if (entry.elements.size() < 3 || entry.elements[2].elements.size() < 2)
+        {
+            continue;
+        }
+        const long long start = entry.elements[0].integer;
+        const long long end = entry.elements[1].integer;
+        const auto &primary = entry.elements[2].elements;
+        // an empty host means the node we asked
+        const std::string hostname = primary[0].str.empty() ? seed_hostname : primary[0].str;
+        const size_t index = node_index(hostname, std::to_string(primary[1].integer));
+        for (long long slot = start; slot <= end && slot < slot_count; slot++)
+        {
+            slot_nodes[slot] = index;
+            covered[slot] = true;
+        }
+    }
+
+    for (uint16_t slot = 0; slot < slot_count; slot++)
+    {
+        if (!covered[slot])
+        {
+            throw std::runtime_error("CLUSTER SLOTS: slot " + std::to_string(slot) + " is not served");
+        }
+    }
+}
+
+size_t RedisCluster::node_index(const std::string &hostname, const std::string &port)
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i]->hostname == hostname && nodes[i]->port == port)
+        {
+            return i;
+        }
+    }
+    std::unique_ptr<node_t> node(new node_t());
+    node->hostname = hostname;
+    node->port = port;
+    node->connection.set_socket_buffer_size(socket_buffer_size);
+    nodes.push_back(std::move(node));
+    return nodes.size() - 1;
+}
+
+// "MOVED <slot> <host>:<port>" or "ASK <slot> <host>:<port>"
+bool RedisCluster::parse_redirect(const std::string &error, size_t &node, bool &asking)
+{
+    const bool moved = error.compare(0, 6, "MOVED ") == 0;
+    asking = error.compare(0, 4, "ASK ") == 0;
+    if (!moved && !asking)
+    {
+        return false;
+    }
+
+    const size_t slot_begin = error.find(' ') + 1;
+    const size_t address_begin = error.find(' ', slot_begin);
+    const size_t colon = error.rfind(':');
+    if (address_begin == std::string::npos || colon == std::string::npos || colon < address_begin)
+    {
+        return false;
+    }
+    const long slot = std::strtol(error.c_str() + slot_begin, nullptr, 10);
+    std::string hostname = error.substr(address_begin + 1, colon - address_begin - 1);
+    if (hostname.empty())
+    {
+        hostname = seed_hostname;
+    }
+    node = node_index(hostname, error.substr(colon + 1));
+    if (moved && slot >= 0 && slot < slot_count)
+    {
+        slot_nodes[slot] = node;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef INCLUDE_GUARD_REDIS_CLUSTER_HPP
+#define INCLUDE_GUARD_REDIS_CLUSTER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "redis-connection.hpp"
+#include "resp-encoder.hpp"
+
+// pipelined writes to a redis cluster. the slot map is read with
+// CLUSTER SLOTS from a seed node, every command is routed to the primary
+// serving the hash slot of its key, and each primary gets its own
+// connection and pipeline. MOVED updates the slot map, ASK is followed
+// once; both resend the command to the named node.
+// every connection failure throws std::runtime_error, the caller should
+// close() and connect() again, which also reloads the slot map.
+class RedisCluster
+{
+public:
+    static const uint16_t slot_count = 16384;
+
+    RedisCluster();
+    RedisCluster(RedisCluster const &) = delete;
+    RedisCluster &operator=(RedisCluster const &) = delete;
+
+    void connect(const std::string &hostname, const std::string &port);
+    void close();
+    // SO_SNDBUF and SO_RCVBUF of the following node connections, 0 keeps the system default
+    void set_socket_buffer_size(int bytes);
+    bool is_connected() const;
+
+    // CRC16 of the key, or of its {hash tag}, modulo 16384
+    static uint16_t key_slot(std::string_view key);
+
+    // `encode` appends exactly one command for `key` to the given encoder
+    template <typename F>
+    void append(std::string_view key, F &&encode)
+    {
+        const uint16_t slot = key_slot(key);
+        node_t &node = *nodes[slot_nodes[slot]];
+        const size_t begin = node.encoder.size();
+        encode(node.encoder);
+        node.commands.push_back(command_t{begin, node.encoder.size()});
+    }
+
+    // sends every pipeline, then reads the replies. redirected commands are
+    // sent again, at most `max_redirects` times. other error replies are
+    // passed to `on_error`.
+    void execute(const std::function<void(const std::string &)> &on_error);
+
+    // primaries currently known
+    size_t size() const;
+
+private:
+    typedef struct Command
+    {
+        size_t begin;
+        size_t end;
+    } command_t;
+
+    typedef struct Node
+    {
+        std::string hostname;
+        std::string port;
+        RedisConnection connection;
+        RespEncoder encoder;
+        std::vector<command_t> commands;
+    } node_t;
+
+    typedef struct Redirect
+    {
+        size_t node;
+        bool asking;
+        std::string command;
+    } redirect_t;
+
+    std::string seed_hostname;
+    int socket_buffer_size;
+    std::vector<std::unique_ptr<node_t>> nodes;
+    // index into nodes for every slot
+    std::vector<size_t> slot_nodes;
+    std::vector<redirect_t> redirects;
+    RedisConnection::reply_t reply;
+
+    void load_slots(RedisConnection &connection);
+    size_t node_index(const std::string &hostname, const std::string &port);
+    bool parse_redirect(const std::string &error, size_t &node, bool &asking);
+};
+
+#endif // INCLUDE_GUARD_REDIS_CLUSTER_HPP
@@ -0,0 +1,297 @@
+#include "redis-connection.hpp"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+
+RedisConnection::RedisConnection()
+{
+    fd = -1;
+    socket_buffer_size = 0;
+    read_buffer.resize(64 * 1024);
+    read_begin = 0;
+    read_end = 0;
+}
+
+RedisConnection::~RedisConnection()
+{
+    close();
+}
+
+void RedisConnection::connect(const std::string &hostname, const std::string &port)
+{
+    close();
+
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result = nullptr;
+    int rc = getaddrinfo(hostname.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0)
+    {
+        throw std::runtime_error("getaddrinfo: " + hostname + ":" + port + ": " + gai_strerror(rc));
+    }
+
+    for (struct addrinfo *ai = result; ai != nullptr; ai = ai->ai_next)
+    {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        apply_socket_buffer_size();
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("connect: " + hostname + ":" + port + ": " + std::strerror(errno));
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void RedisConnection::connect_unix(const std::string &path)
+{
+    close();
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        throw std::runtime_error("connect: " + path + ": path too long");
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    apply_socket_buffer_size();
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        const int error = errno;
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("connect: " + path + ": " + std::strerror(error));
+    }
+}
+
+void RedisConnection::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    read_begin = 0;
+    read_end = 0;
+}
+
+bool RedisConnection::is_connected() const
+{
+    return fd >= 0;
+}
+
+void RedisConnection::set_socket_buffer_size(int bytes)
+{
+    socket_buffer_size = bytes;
+}
+
+// before connect(), so TCP negotiates its window scale for the larger buffer
+void RedisConnection::apply_socket_buffer_size()
+{
+    if (socket_buffer_size > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &socket_buffer_size, sizeof(socket_buffer_size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &socket_buffer_size, sizeof(socket_buffer_size));
+    }
+}
+
+void RedisConnection::send(const struct iovec *iov, int iovcnt)
+{
+    std::vector<struct iovec> rest;
+
+    while (iovcnt > 0)
+    {
+        ssize_t n = ::writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fail(std::string("writev: ") + std::strerror(errno));
+        }
+
+        // skip what was written, a partial write leaves a shortened head
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0 && n > 0)
+        {
+            rest.assign(iov, iov + iovcnt);
+            rest[0].iov_base = (char *)rest[0].iov_base + n;
+            rest[0].iov_len -= n;
+            iov = rest.data();
+        }
+    }
+}
+
+void RedisConnection::send(const RespEncoder &encoder)
+{
+    struct iovec iov;
+    iov.iov_base = (void *)encoder.data();
+    iov.iov_len = encoder.size();
+    send(&iov, 1);
+}
+
+void RedisConnection::read_reply(reply_t &reply)
+{
+    size_t length;
+    const char *line = read_line(length);
+
+    reply.type = line[0];
+    reply.is_null = false;
+    reply.integer = 0;
+    reply.str.clear();
+    reply.elements.clear();
+
+    switch (reply.type)
+    {
+    case '+':
+    case '-':
+        reply.str.assign(line + 1, length - 1);
+        break;
+    case ':':
+        reply.integer = std::strtoll(line + 1, nullptr, 10);
+        break;
+    case '$':
+    {
+        long long n = std::strtoll(line + 1, nullptr, 10);
+        if (n < 0)
+        {
+            reply.is_null = true;
+            break;
+        }
+        read_bytes(reply.str, (size_t)n);
+        break;
+    }
+    case '*':
+    {
+        long long n = std::strtoll(line + 1, nullptr, 10);
+        if (n < 0)
+        {
+            reply.is_null = true;
+            break;
+        }
+        reply.elements.resize((size_t)n);
+        for (auto &element : reply.elements)
+        {
+            read_reply(element);
+        }
+        break;
+    }
+    default:
+        fail("protocol error: unexpected reply type");
+    }
+}
+
+void RedisConnection::fill()
+{
+    if (fd < 0)
+    {
+        throw std::runtime_error("not connected");
+    }
+
+    // move unread data to the front, grow only if a single reply does not fit
+    if (read_begin > 0)
+    {
+        std::memmove(read_buffer.data(), read_buffer.data() + read_begin, read_end - read_begin);
+        read_end -= read_begin;
+        read_begin = 0;
+    }
+    if (read_end == read_buffer.size())
+    {
+        read_buffer.resize(read_buffer.size() * 2);
+    }
+
+    while (true)
+    {
+        ssize_t n = ::recv(fd, read_buffer.data() + read_end, read_buffer.size() - read_end, 0);
+        if (n > 0)
+        {
+            read_end += n;
+            return;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        fail(n == 0 ? "connection closed by server" : std::string("recv: ") + std::strerror(errno));
+    }
+}
+
+const char *RedisConnection::read_line(size_t &length)
+{
+    while (true)
+    {
+        const char *begin = read_buffer.data() + read_begin;
+        const char *end = read_buffer.data() + read_end;
+        const char *cr = (const char *)std::memchr(begin, '\r', end - begin);
+        if (cr != nullptr && cr + 1 < end)
+        {
+            length = cr - begin;
+            read_begin += length + 2;
+            return begin;
+        }
+        fill();
+    }
+}
+
+void RedisConnection::read_bytes(std::string &out, size_t n)
+{
+    // bulk string payload followed by CRLF
+    size_t remaining = n + 2;
+    out.reserve(n);
+    while (remaining > 0)
+    {
+        if (read_begin == read_end)
+        {
+            fill();
+        }
+        size_t take = std::min(read_end - read_begin, remaining);
+        size_t copy = std::min(take, n - out.size());
+        out.append(read_buffer.data() + read_begin, copy);
+        read_begin += take;
+        remaining -= take;
+    }
+}
+
+void RedisConnection::fail(const std::string &what)
+{
+    close();
+    throw std::runtime_error(what);
+}
@@ -0,0 +1,60 @@
+#ifndef INCLUDE_GUARD_REDIS_CONNECTION_HPP
+#define INCLUDE_GUARD_REDIS_CONNECTION_HPP
+
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#include "resp-encoder.hpp"
+
+// a blocking connection to redis-server over a plain socket.
+// requests are written with writev, replies are parsed from an internal
+// read buffer. every failure throws std::runtime_error and closes the socket.
+class RedisConnection
+{
+public:
+    typedef struct Reply
+    {
+        char type = 0; // one of + - : $ *
+        bool is_null = false;
+        long long integer = 0;
+        std::string str;
+        std::vector<Reply> elements;
+
+        bool is_error() const { return type == '-'; }
+    } reply_t;
+
+    RedisConnection();
+    ~RedisConnection();
+    RedisConnection(RedisConnection const &) = delete;
+    RedisConnection &operator=(RedisConnection const &) = delete;
+
+    void connect(const std::string &hostname, const std::string &port);
+    // redis-server on this host, listening on a unix domain socket
+    void connect_unix(const std::string &path);
+    void close();
+    bool is_connected() const;
+
+    // SO_SNDBUF and SO_RCVBUF of the following connects, set before connecting.
+    // 0 keeps the system default
+    void set_socket_buffer_size(int bytes);
+
+    void send(const struct iovec *iov, int iovcnt);
+    void send(const RespEncoder &encoder);
+
+    void read_reply(reply_t &reply);
+
+private:
+    int fd;
+    int socket_buffer_size;
+    std::vector<char> read_buffer;
+    size_t read_begin;
+    size_t read_end;
+
+    void apply_socket_buffer_size();
+    void fill();
+    const char *read_line(size_t &length);
+    void read_bytes(std::string &out, size_t n);
+    [[noreturn]] void fail(const std::string &what);
+};
+
+#endif // INCLUDE_GUARD_REDIS_CONNECTION_HPP
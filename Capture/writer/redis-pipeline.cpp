@@ -0,0 +1,92 @@
+#include "redis-pipeline.hpp"
+#include <iostream>
+#include <stdexcept>
+
+RedisPipeline::RedisPipeline(const RedisSink::config_t &c)
+{
+    config = c;
+    commands = 0;
+    connection.set_socket_buffer_size(config.socket_buffer_size);
+    cluster.set_socket_buffer_size(config.socket_buffer_size);
+}
+
+void RedisPipeline::execute(const char *name)
+{
+    if (commands == 0)
+    {
+        return;
+    }
+    try
+    {
+        if (config.cluster)
+        {
+            cluster.execute([name](const std::string &error) {
+                std::cout << name << ": Redis error: " << error << std::endl;
+            });
+        }
+        else
+        {
+            connection.send(encoder);
+            for (size_t i = 0; i < encoder.commands(); i++)
+            {
+                connection.read_reply(reply);
+                if (reply.is_error())
+                {
+                    std::cout << name << ": Redis error: " << reply.str << std::endl;
+                }
+            }
+        }
+    }
+    catch (std::runtime_error &e)
+    {
+        reset();
+        throw;
+    }
+    encoder.clear();
+    commands = 0;
+}
+
+void RedisPipeline::connect()
+{
+    try
+    {
+        if (config.cluster)
+        {
+            if (!cluster.is_connected())
+            {
+                cluster.connect(config.hostname, config.port);
+            }
+            return;
+        }
+        if (connection.is_connected())
+        {
+            return;
+        }
+        if (config.unix_socket != "")
+        {
+            connection.connect_unix(config.unix_socket);
+        }
+        else
+        {
+            connection.connect(config.hostname, config.port);
+        }
+    }
+    catch (std::runtime_error &e)
+    {
+        reset();
+        throw;
+    }
+    // a reconnect drops what was appended for the old connection
+    encoder.clear();
+    commands = 0;
+    encoder.append_command({"SELECT", config.database_number});
+}
+
+void RedisPipeline::reset()
+{
+    // reconnecting reloads the slot map
+    cluster.close();
+    connection.close();
+    encoder.clear();
+    commands = 0;
+}
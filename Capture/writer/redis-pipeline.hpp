@@ -0,0 +1,53 @@
+#ifndef INCLUDE_GUARD_REDIS_PIPELINE_HPP
+#define INCLUDE_GUARD_REDIS_PIPELINE_HPP
+
+#include <string>
+#include "redis-sink.hpp"
+#include "redis-connection.hpp"
+#include "redis-cluster.hpp"
+#include "resp-encoder.hpp"
+
+// commands of a sink that writes its own entries to redis, e.g. finished
+// recordings, with the connection settings of RedisSink. connects on the
+// first append(), execute() sends everything appended since as one pipeline.
+// connection failures throw std::runtime_error and drop the pipeline, the
+// next append() connects again.
+class RedisPipeline
+{
+public:
+    explicit RedisPipeline(const RedisSink::config_t &c);
+    RedisPipeline(RedisPipeline const &) = delete;
+    RedisPipeline &operator=(RedisPipeline const &) = delete;
+
+    // `encode` appends exactly one command for `key` to the given encoder
+    template <typename F>
+    void append(const std::string &key, F &&encode)
+    {
+        connect();
+        if (config.cluster)
+        {
+            cluster.append(key, encode);
+        }
+        else
+        {
+            encode(encoder);
+        }
+        commands++;
+    }
+
+    // error replies are printed with `name`
+    void execute(const char *name);
+
+private:
+    RedisSink::config_t config;
+    RedisConnection connection;
+    RedisCluster cluster;
+    RespEncoder encoder;
+    RedisConnection::reply_t reply;
+    size_t commands;
+
+    void connect();
+    void reset();
+};
+
+#endif // INCLUDE_GUARD_REDIS_PIPELINE_HPP
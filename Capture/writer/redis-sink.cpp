@@ -0,0 +1,128 @@
+#include "redis-sink.hpp"
+#include <iostream>
+#include <stdexcept>
+
+RedisSink::RedisSink(const config_t &c)
+{
+    config = c;
+    stream_max_length_str = std::to_string(config.stream_max_length);
+    connection.set_socket_buffer_size(config.socket_buffer_size);
+    cluster.set_socket_buffer_size(config.socket_buffer_size);
+}
+
+const char *RedisSink::name() const
+{
+    return "Redis";
+}
+
+void RedisSink::write(const Parser::datagram_t *datagrams, size_t count,
+                      const FlowTable::record_t *flows, size_t flow_count)
+{
+    try
+    {
+        connect();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            append_xadd(datagrams[i].stream_key, datagrams[i]);
+            if (!datagrams[i].second_stream_key.empty() && !datagrams[i].second_stream_copied)
+            {
+                append_xadd(datagrams[i].second_stream_key, datagrams[i]);
+            }
+        }
+        for (size_t i = 0; i < flow_count; i++)
+        {
+            append(config.flow_stream_key, [&](RespEncoder &e) { e.append_xadd_flow(config.flow_stream_key, flows[i]); });
+        }
+
+        if (config.stream_max_length > 0)
+        {
+            append("test-stream", [&](RespEncoder &e) { e.append_command({"XTRIM", "test-stream", "MAXLEN", "~", stream_max_length_str}); });
+        }
+
+        execute();
+    }
+    catch (std::runtime_error &e)
+    {
+        // reconnecting reloads the slot map
+        cluster.close();
+        encoder.clear();
+        throw;
+    }
+    encoder.clear();
+}
+
+void RedisSink::connect()
+{
+    if (config.cluster)
+    {
+        if (!cluster.is_connected())
+        {
+            cluster.connect(config.hostname, config.port);
+        }
+        return;
+    }
+    if (connection.is_connected())
+    {
+        return;
+    }
+    if (config.unix_socket != "")
+    {
+        connection.connect_unix(config.unix_socket);
+    }
+    else
+    {
+        connection.connect(config.hostname, config.port);
+    }
+    encoder.append_command({"SELECT", config.database_number});
+}
+
+void RedisSink::execute()
+{
+    if (config.cluster)
+    {
+        cluster.execute([](const std::string &error) {
+            std::cout << "Redis: Error:" << error << std::endl;
+        });
+        return;
+    }
+
+    connection.send(encoder);
+
+    for (size_t i = 0; i < encoder.commands(); i++)
+    {
+        connection.read_reply(reply);
+        if (reply.is_error())
+        {
+            std::cout << "Redis: Error:" << reply.str << std::endl;
+        }
+    }
+}
+
+// appends one command for `key`, in cluster mode to the pipeline of the node serving it
+template <typename F>
+void RedisSink::append(const std::string &key, F &&encode)
+{
+    if (config.cluster)
+    {
+        cluster.append(key, encode);
+    }
+    else
+    {
+        encode(encoder);
+    }
+}
+
+void RedisSink::append_xadd(const std::string &key, const Parser::datagram_t &value)
+{
+    append(key, [&](RespEncoder &e) {
+        if (config.packed)
+        {
+            e.append_xadd_packed(key, value);
+        }
+        else
+        {
+            e.append_xadd(key, value);
+        }
+    });
+}
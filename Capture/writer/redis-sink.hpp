@@ -0,0 +1,50 @@
+#ifndef INCLUDE_GUARD_REDIS_SINK_HPP
+#define INCLUDE_GUARD_REDIS_SINK_HPP
+
+#include <string>
+#include "sink.hpp"
+#include "redis-connection.hpp"
+#include "redis-cluster.hpp"
+#include "resp-encoder.hpp"
+
+// XADDs every datagram to redis streams, as one pipeline per write().
+class RedisSink : public Sink
+{
+public:
+    typedef struct Config
+    {
+        std::string hostname = "127.0.0.1";
+        std::string port = "6379";
+        // used instead of hostname and port if set
+        std::string unix_socket = "";
+        int socket_buffer_size = 0;
+        std::string database_number = "0";
+        // hostname and port name a seed node of a redis cluster
+        bool cluster = false;
+        bool packed = false;
+        int stream_max_length = 0;
+        std::string flow_stream_key = "stream/flows";
+    } config_t;
+
+    explicit RedisSink(const config_t &c);
+
+    const char *name() const override;
+    void write(const Parser::datagram_t *datagrams, size_t count,
+               const FlowTable::record_t *flows, size_t flow_count) override;
+
+private:
+    config_t config;
+    std::string stream_max_length_str;
+    RedisConnection connection;
+    RedisCluster cluster;
+    RespEncoder encoder;
+    RedisConnection::reply_t reply;
+
+    void connect();
+    void execute();
+    template <typename F>
+    void append(const std::string &key, F &&encode);
+    void append_xadd(const std::string &key, const Parser::datagram_t &value);
+};
+
+#endif // INCLUDE_GUARD_REDIS_SINK_HPP
@@ -0,0 +1,363 @@
+#include "resp-encoder.hpp"
+#include <cstring>
+#include <arpa/inet.h>
+
+namespace
+{
+    const char *const datagram_field_names[13] = {
+        "layer_2_type",
+        "layer_2_src_addr",
+        "layer_2_dst_addr",
+        "layer_3_type",
+        "layer_3_src_addr",
+        "layer_3_dst_addr",
+        "layer_4_type",
+        "layer_4_src_port",
+        "layer_4_dst_port",
+        "payload_type",
+        "payload_size",
+        "payload_encoding_type",
+        "payload_payload",
+    };
+
+    // only added to an entry when the datagram has a value for them
+    const char *const optional_field_names[9] = {
+        "payload_compression",
+        "vlan_ids",
+        "mpls_labels",
+        "tunnel_type",
+        "tunnel_id",
+        "media_type",
+        "call_id",
+        "sip_from",
+        "sip_to",
+    };
+
+    const char *const flow_field_names[14] = {
+        "layer_3_type",
+        "layer_4_type",
+        "addr_a",
+        "port_a",
+        "addr_b",
+        "port_b",
+        "first_seen_usec",
+        "last_seen_usec",
+        "packets_a_to_b",
+        "bytes_a_to_b",
+        "packets_b_to_a",
+        "bytes_b_to_a",
+        "tcp_flags",
+        "end_reason",
+    };
+
+    // "*" or "$", up to 20 digits and CRLF
+    const size_t max_length_size = 1 + 20 + 2;
+
+    // writes the decimal digits of n right-aligned before `end` and returns the first digit
+    inline char *format_uint(char *end, size_t n)
+    {
+        char *p = end;
+        do
+        {
+            *--p = (char)('0' + n % 10);
+            n /= 10;
+        } while (n != 0);
+        return p;
+    }
+}
+
+RespEncoder::RespEncoder()
+{
+    buffer_size = 0;
+    buffer_capacity = 0;
+    command_count = 0;
+    reserve(1024 * 1024);
+
+    // XADD <key> * <13 field/value pairs> [<optional field/value pairs>]
+    xadd_name = to_bulk_string("XADD");
+    for (int i = 0; i < 13; i++)
+    {
+        field_names[i] = to_bulk_string(datagram_field_names[i]);
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        optional_field_names[i] = to_bulk_string(::optional_field_names[i]);
+    }
+
+    // XADD <key> * record <packed record>
+    xadd_packed_header = "*5\r\n" + to_bulk_string("XADD");
+    record_field_name = to_bulk_string("record");
+
+    for (int i = 0; i < 14; i++)
+    {
+        flow_field_names[i] = to_bulk_string(::flow_field_names[i]);
+    }
+}
+
+void RespEncoder::clear()
+{
+    buffer_size = 0;
+    command_count = 0;
+}
+
+const char *RespEncoder::data() const
+{
+    return buffer.get();
+}
+
+size_t RespEncoder::size() const
+{
+    return buffer_size;
+}
+
+size_t RespEncoder::commands() const
+{
+    return command_count;
+}
+
+void RespEncoder::append_command(std::initializer_list<std::string_view> args)
+{
+    append_command(args.begin(), args.size());
+}
+
+void RespEncoder::append_command(const std::string_view *args, size_t count)
+{
+    size_t needed = max_length_size;
+    for (size_t i = 0; i < count; i++)
+    {
+        needed += max_length_size + args[i].size() + 2;
+    }
+    reserve(buffer_size + needed);
+
+    char *p = buffer.get() + buffer_size;
+    p = write_length(p, '*', count);
+    for (size_t i = 0; i < count; i++)
+    {
+        p = write_bulk_string(p, args[i].data(), args[i].size());
+    }
+    buffer_size = p - buffer.get();
+    command_count++;
+}
+
+void RespEncoder::append_raw(const char *data, size_t size)
+{
+    reserve(buffer_size + size);
+    std::memcpy(buffer.get() + buffer_size, data, size);
+    buffer_size += size;
+    command_count++;
+}
+
+void RespEncoder::append_xadd(const std::string &key, const Parser::datagram_t &value)
+{
+    static const char id[] = "$1\r\n*\r\n";
+
+    const std::string *values[13] = {
+        &value.layer_2_type,
+        &value.layer_2_src_addr,
+        &value.layer_2_dst_addr,
+        &value.layer_3_type,
+        &value.layer_3_src_addr,
+        &value.layer_3_dst_addr,
+        &value.layer_4_type,
+        &value.layer_4_src_port,
+        &value.layer_4_dst_port,
+        &value.payload_type,
+        &value.payload_size,
+        &value.payload_encoding_type,
+        &value.payload,
+    };
+
+    const std::string *optional_values[9] = {
+        &value.payload_compression,
+        &value.vlan_ids,
+        &value.mpls_labels,
+        &value.tunnel_type,
+        &value.tunnel_id,
+        &value.media_type,
+        &value.call_id,
+        &value.sip_from,
+        &value.sip_to,
+    };
+
+    // size the whole command once, then write it without further checks
+    size_t arguments = 3 + 13 * 2;
+    size_t needed = max_length_size + xadd_name.size() + max_length_size + key.size() + 2 + sizeof(id) - 1;
+    for (int i = 0; i < 13; i++)
+    {
+        needed += field_names[i].size() + max_length_size + values[i]->size() + 2;
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        if (!optional_values[i]->empty())
+        {
+            arguments += 2;
+            needed += optional_field_names[i].size() + max_length_size + optional_values[i]->size() + 2;
+        }
+    }
+    reserve(buffer_size + needed);
+
+    char *p = buffer.get() + buffer_size;
+    p = write_length(p, '*', arguments);
+    p = write_raw(p, xadd_name);
+    p = write_bulk_string(p, key.data(), key.size());
+    std::memcpy(p, id, sizeof(id) - 1);
+    p += sizeof(id) - 1;
+    for (int i = 0; i < 13; i++)
+    {
+        p = write_raw(p, field_names[i]);
+        p = write_bulk_string(p, values[i]->data(), values[i]->size());
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        if (!optional_values[i]->empty())
+        {
+            p = write_raw(p, optional_field_names[i]);
+            p = write_bulk_string(p, optional_values[i]->data(), optional_values[i]->size());
+        }
+    }
+    buffer_size = p - buffer.get();
+    command_count++;
+}
+
+void RespEncoder::append_xadd_packed(const std::string &key, const Parser::datagram_t &value)
+{
+    static const char id[] = "$1\r\n*\r\n";
+
+    size_t needed = xadd_packed_header.size() + max_length_size + key.size() + 2 + sizeof(id) - 1 +
+                    record_field_name.size() + max_length_size + value.record.size() + 2;
+    reserve(buffer_size + needed);
+
+    char *p = buffer.get() + buffer_size;
+    p = write_raw(p, xadd_packed_header);
+    p = write_bulk_string(p, key.data(), key.size());
+    std::memcpy(p, id, sizeof(id) - 1);
+    p += sizeof(id) - 1;
+    p = write_raw(p, record_field_name);
+    p = write_bulk_string(p, value.record.data(), value.record.size());
+    buffer_size = p - buffer.get();
+    command_count++;
+}
+
+void RespEncoder::append_xadd_flow(const std::string &key, const FlowTable::record_t &value)
+{
+    static const char id[] = "$1\r\n*\r\n";
+
+    char addr_a[INET6_ADDRSTRLEN] = "";
+    char addr_b[INET6_ADDRSTRLEN] = "";
+    const int family = value.key.layer_3_type == PackedRecord::IPv6 ? AF_INET6 : AF_INET;
+    inet_ntop(family, value.key.addr_a, addr_a, sizeof(addr_a));
+    inet_ntop(family, value.key.addr_b, addr_b, sizeof(addr_b));
+
+    const uint64_t numbers[10] = {
+        value.key.port_a,
+        value.key.port_b,
+        value.first_seen_usec,
+        value.last_seen_usec,
+        value.packets_a_to_b,
+        value.bytes_a_to_b,
+        value.packets_b_to_a,
+        value.bytes_b_to_a,
+        value.tcp_flags,
+        value.end_reason,
+    };
+    char digits[10][20];
+    std::string_view number_values[10];
+    for (int i = 0; i < 10; i++)
+    {
+        char *end = digits[i] + sizeof(digits[i]);
+        char *begin = format_uint(end, numbers[i]);
+        number_values[i] = std::string_view(begin, end - begin);
+    }
+
+    const std::string_view values[14] = {
+        PackedRecord::type_to_string(value.key.layer_3_type),
+        PackedRecord::type_to_string(value.key.layer_4_type),
+        addr_a,
+        number_values[0],
+        addr_b,
+        number_values[1],
+        number_values[2],
+        number_values[3],
+        number_values[4],
+        number_values[5],
+        number_values[6],
+        number_values[7],
+        number_values[8],
+        number_values[9],
+    };
+
+    size_t needed = max_length_size + xadd_name.size() + max_length_size + key.size() + 2 + sizeof(id) - 1;
+    for (int i = 0; i < 14; i++)
+    {
+        needed += flow_field_names[i].size() + max_length_size + values[i].size() + 2;
+    }
+    reserve(buffer_size + needed);
+
+    char *p = buffer.get() + buffer_size;
+    p = write_length(p, '*', 3 + 14 * 2);
+    p = write_raw(p, xadd_name);
+    p = write_bulk_string(p, key.data(), key.size());
+    std::memcpy(p, id, sizeof(id) - 1);
+    p += sizeof(id) - 1;
+    for (int i = 0; i < 14; i++)
+    {
+        p = write_raw(p, flow_field_names[i]);
+        p = write_bulk_string(p, values[i].data(), values[i].size());
+    }
+    buffer_size = p - buffer.get();
+    command_count++;
+}
+
+void RespEncoder::reserve(size_t n)
+{
+    if (n <= buffer_capacity)
+    {
+        return;
+    }
+    size_t capacity = buffer_capacity == 0 ? 4096 : buffer_capacity;
+    while (capacity < n)
+    {
+        capacity *= 2;
+    }
+    std::unique_ptr<char[]> grown(new char[capacity]);
+    if (buffer_size > 0)
+    {
+        std::memcpy(grown.get(), buffer.get(), buffer_size);
+    }
+    buffer.swap(grown);
+    buffer_capacity = capacity;
+}
+
+char *RespEncoder::write_raw(char *p, const std::string &s)
+{
+    std::memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+char *RespEncoder::write_length(char *p, char prefix, size_t n)
+{
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *begin = format_uint(end, n);
+    *p++ = prefix;
+    std::memcpy(p, begin, end - begin);
+    p += end - begin;
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+char *RespEncoder::write_bulk_string(char *p, const char *s, size_t n)
+{
+    p = write_length(p, '$', n);
+    std::memcpy(p, s, n);
+    p += n;
+    *p++ = '\r';
+    *p++ = '\n';
+    return p;
+}
+
+std::string RespEncoder::to_bulk_string(const std::string &s)
+{
+    return "$" + std::to_string(s.size()) + "\r\n" + s + "\r\n";
+}
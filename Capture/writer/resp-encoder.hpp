@@ -0,0 +1,58 @@
+#ifndef INCLUDE_GUARD_RESP_ENCODER_HPP
+#define INCLUDE_GUARD_RESP_ENCODER_HPP
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <initializer_list>
+#include "parser.hpp"
+#include "flow-table.hpp"
+
+// serializes redis commands in RESP into one contiguous buffer.
+// the buffer keeps its capacity across clear(), so encoding a batch is a
+// sequence of memcpy into already allocated memory.
+class RespEncoder
+{
+public:
+    RespEncoder();
+
+    void clear();
+    const char *data() const;
+    size_t size() const;
+
+    // number of commands appended since the last clear()
+    size_t commands() const;
+
+    void append_command(std::initializer_list<std::string_view> args);
+    // the same with arguments built at run time
+    void append_command(const std::string_view *args, size_t count);
+    // one already encoded command
+    void append_raw(const char *data, size_t size);
+    void append_xadd(const std::string &key, const Parser::datagram_t &value);
+    // XADD <key> * record <value.record>, see packed-record.hpp
+    void append_xadd_packed(const std::string &key, const Parser::datagram_t &value);
+    // XADD <key> * <flow record fields>
+    void append_xadd_flow(const std::string &key, const FlowTable::record_t &value);
+
+private:
+    std::unique_ptr<char[]> buffer;
+    size_t buffer_size;
+    size_t buffer_capacity;
+    size_t command_count;
+
+    // "$<len>\r\n<name>\r\n" of every datagram field name, built once
+    std::string xadd_name;
+    std::string field_names[13];
+    std::string optional_field_names[9];
+    std::string xadd_packed_header;
+    std::string record_field_name;
+    std::string flow_field_names[14];
+
+    void reserve(size_t n);
+    char *write_raw(char *p, const std::string &s);
+    char *write_length(char *p, char prefix, size_t n);
+    char *write_bulk_string(char *p, const char *s, size_t n);
+    static std::string to_bulk_string(const std::string &s);
+};
+
+#endif // INCLUDE_GUARD_RESP_ENCODER_HPP
@@ -0,0 +1,97 @@
+#ifndef INCLUDE_GUARD_RTP_STREAM_HPP
+#define INCLUDE_GUARD_RTP_STREAM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "parser.hpp"
+#include "flow-key.hpp"
+#include "packed-record.hpp"
+#include "rtp-header.hpp"
+
+// an RTP stream: SSRC and direction of a UDP flow. sinks that follow
+// streams find the RTP packet of a datagram with from_datagram().
+typedef struct RtpStreamKey
+{
+    flow_key_t flow;
+    uint32_t ssrc = 0;
+    // the sender is endpoint "a" of the flow
+    bool forward = false;
+
+    // false for datagrams that are not uncompressed RTP over UDP, for
+    // anything but negotiated RTP when SIP calls are tracked, and for the
+    // second copy of a datagram routed to two writers (Datagram::copy), so
+    // every packet is seen once. needs Datagram::record.
+    static bool from_datagram(const Parser::datagram_t &datagram, RtpStreamKey &key,
+                              PackedRecord::header_t &header, RtpHeader::header_t &rtp)
+    {
+        if (datagram.copy || datagram.header.layer_4_type != PackedRecord::UDP ||
+            (datagram.media != SipTracker::UNTRACKED && datagram.media != SipTracker::RTP))
+        {
+            return false;
+        }
+        const uint8_t *payload = nullptr;
+        if (!PackedRecord::decode(datagram.record.data(), datagram.record.size(), header, payload) ||
+            header.payload_compression != PackedRecord::UNCOMPRESSED ||
+            !RtpHeader::parse(payload, header.payload_size, rtp))
+        {
+            return false;
+        }
+        key.flow = FlowKey::from_header(header, &key.forward);
+        key.ssrc = rtp.ssrc;
+        return true;
+    }
+
+    bool operator==(const RtpStreamKey &other) const
+    {
+        return flow == other.flow && ssrc == other.ssrc && forward == other.forward;
+    }
+} rtp_stream_key_t;
+
+struct RtpStreamKeyHash
+{
+    size_t operator()(const RtpStreamKey &key) const
+    {
+        return (size_t)(key.flow.hash() ^ ((uint64_t)key.ssrc << 1 | key.forward) * 0x9e3779b97f4a7c15ULL);
+    }
+};
+
+// places the samples of in order packets by their RTP timestamp. a gap of
+// up to max_gap samples, e.g. lost packets or comfort noise, is filled,
+// samples written already are skipped, and longer jumps in either
+// direction, e.g. a restarted sender, continue without a gap.
+typedef struct RtpTimeline
+{
+    // RTP timestamp following the last placed sample
+    uint32_t next_timestamp = 0;
+    bool started = false;
+
+    // returns false if the packet only repeats placed samples. otherwise
+    // `fill` samples go before the packet and its first `skip` samples are
+    // dropped.
+    bool place(uint32_t timestamp, size_t count, uint32_t max_gap, size_t &fill, size_t &skip)
+    {
+        fill = 0;
+        skip = 0;
+        if (started)
+        {
+            const int64_t gap = (int32_t)(timestamp - next_timestamp);
+            if (gap > 0 && gap <= (int64_t)max_gap)
+            {
+                fill = (size_t)gap;
+            }
+            else if (gap < 0 && -gap < (int64_t)count)
+            {
+                skip = (size_t)-gap;
+            }
+            else if (gap < 0 && -gap <= (int64_t)max_gap)
+            {
+                return false;
+            }
+        }
+        next_timestamp = timestamp + (uint32_t)count;
+        started = true;
+        return true;
+    }
+} rtp_timeline_t;
+
+#endif // INCLUDE_GUARD_RTP_STREAM_HPP
@@ -0,0 +1,31 @@
+#include "shm-sink.hpp"
+
+ShmSink::ShmSink(const config_t &c)
+{
+    ring.reset(new ShmRing::Writer(c.name, c.size));
+}
+
+const char *ShmSink::name() const
+{
+    return "Shm";
+}
+
+void ShmSink::write(const Parser::datagram_t *datagrams, size_t count,
+                    const FlowTable::record_t *, size_t)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (datagrams[i].copy)
+        {
+            continue;
+        }
+        uint8_t *p = ring->reserve(entry_size(datagrams[i]));
+        if (p == nullptr)
+        {
+            // larger than the whole ring
+            continue;
+        }
+        write_entry(p, datagrams[i]);
+        ring->commit();
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef INCLUDE_GUARD_SHM_SINK_HPP
+#define INCLUDE_GUARD_SHM_SINK_HPP
+
+#include <memory>
+#include <string>
+#include "sink.hpp"
+#include "shm-ring.hpp"
+
+// publishes datagrams as Sink entries in a ShmRing for consumers on the
+// same host. never blocks on consumers. flow records are not published.
+class ShmSink : public Sink
+{
+public:
+    typedef struct Config
+    {
+        std::string name = "/basin-capture";
+        size_t size = 64 * 1024 * 1024;
+    } config_t;
+
+    // throws std::runtime_error if the ring cannot be created
+    explicit ShmSink(const config_t &c);
+
+    const char *name() const override;
+    void write(const Parser::datagram_t *datagrams, size_t count,
+               const FlowTable::record_t *flows, size_t flow_count) override;
+
+private:
+    std::unique_ptr<ShmRing::Writer> ring;
+};
+
+#endif // INCLUDE_GUARD_SHM_SINK_HPP
@@ -0,0 +1,55 @@
+#ifndef INCLUDE_GUARD_SINK_HPP
+#define INCLUDE_GUARD_SINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "parser.hpp"
+#include "flow-table.hpp"
+
+// destination of parsed datagrams, driven by a writer thread.
+// write() stores each datagram under its stream_key and second_stream_key.
+// sinks keeping one entry per datagram skip Datagram::copy, the original
+// carries both keys.
+// failures throw std::runtime_error; the datagrams of that call are lost
+// for this sink and the next call starts over, e.g. with a new connection.
+class Sink
+{
+public:
+    virtual ~Sink() {}
+
+    virtual const char *name() const = 0;
+    virtual void write(const Parser::datagram_t *datagrams, size_t count,
+                       const FlowTable::record_t *flows, size_t flow_count) = 0;
+    // called by the writer about once a second, also while no datagrams
+    // arrive, for work driven by time. may throw like write().
+    virtual void poll() {}
+
+    // binary entry of the file and shared memory sinks, little endian:
+    //   u16 stream_key size, stream_key, u16 second_stream_key size,
+    //   second_stream_key, Datagram::record (see packed-record.hpp)
+    static size_t entry_size(const Parser::datagram_t &value)
+    {
+        return 2 + value.stream_key.size() + 2 + value.second_stream_key.size() + value.record.size();
+    }
+
+    static uint8_t *write_entry(uint8_t *p, const Parser::datagram_t &value)
+    {
+        p = write_string(p, value.stream_key);
+        p = write_string(p, value.second_stream_key);
+        std::memcpy(p, value.record.data(), value.record.size());
+        return p + value.record.size();
+    }
+
+private:
+    static uint8_t *write_string(uint8_t *p, const std::string &s)
+    {
+        p[0] = (uint8_t)(s.size() & 0xff);
+        p[1] = (uint8_t)(s.size() >> 8);
+        std::memcpy(p + 2, s.data(), s.size());
+        return p + 2 + s.size();
+    }
+};
+
+#endif // INCLUDE_GUARD_SINK_HPP
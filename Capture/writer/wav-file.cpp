@@ -0,0 +1,249 @@
+#include "wav-file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    // RIFF, fmt (WAVEFORMATEX without extra bytes), fact, JUNK, data
+    const size_t riff_size = 12;
+    const size_t fmt_size = 8 + 18;
+    const size_t fact_size = 8 + 4;
+    const size_t data_header_size = 8;
+    const size_t junk_size = WavFile::block_size - riff_size - fmt_size - fact_size - data_header_size;
+
+    void put_le16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    void put_le32(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+
+    uint8_t *aligned_alloc_or_throw(size_t size)
+    {
+        void *p = nullptr;
+        if (posix_memalign(&p, WavFile::block_size, size) != 0)
+        {
+            throw std::runtime_error("posix_memalign failed");
+        }
+        return (uint8_t *)p;
+    }
+}
+
+WavFile::WavFile(const std::string &p, format f, uint32_t sample_rate, const config_t &c)
+{
+    path = p;
+    config = c;
+    config.buffer_size = (config.buffer_size + block_size - 1) / block_size * block_size;
+    if (config.buffer_size == 0)
+    {
+        config.buffer_size = block_size;
+    }
+    sample_format = f;
+    rate = sample_rate;
+    buffer_used = 0;
+    offset = block_size;
+    allocated = 0;
+    samples_size = 0;
+    buffer = nullptr;
+    header = nullptr;
+
+    const int flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+    if (config.direct)
+    {
+        fd = open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL)
+        {
+            // the file system has no O_DIRECT. linux creates the file before
+            // it finds out, so it is ours already
+            fd = open(path.c_str(), flags & ~O_EXCL, 0644);
+        }
+    }
+    else
+    {
+        fd = open(path.c_str(), flags, 0644);
+    }
+    if (fd < 0)
+    {
+        throw std::runtime_error("open: " + path + ": " + std::strerror(errno));
+    }
+
+    try
+    {
+        buffer = aligned_alloc_or_throw(config.buffer_size);
+        header = aligned_alloc_or_throw(block_size);
+        write_header(false);
+    }
+    catch (std::runtime_error &e)
+    {
+        std::free(buffer);
+        std::free(header);
+        ::close(fd);
+        throw;
+    }
+}
+
+WavFile::~WavFile()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+    std::free(buffer);
+    std::free(header);
+}
+
+void WavFile::write(const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        const size_t count = std::min(size, config.buffer_size - buffer_used);
+        std::memcpy(buffer + buffer_used, data, count);
+        buffer_used += count;
+        samples_size += count;
+        data += count;
+        size -= count;
+        if (buffer_used == config.buffer_size)
+        {
+            flush_buffer(config.buffer_size);
+        }
+    }
+}
+
+void WavFile::fill(uint8_t value, size_t count)
+{
+    while (count > 0)
+    {
+        const size_t n = std::min(count, config.buffer_size - buffer_used);
+        std::memset(buffer + buffer_used, value, n);
+        buffer_used += n;
+        samples_size += n;
+        count -= n;
+        if (buffer_used == config.buffer_size)
+        {
+            flush_buffer(config.buffer_size);
+        }
+    }
+}
+
+void WavFile::close()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    // chunks are padded to an even size
+    if (samples_size & 1)
+    {
+        buffer[buffer_used++] = 0;
+    }
+    const uint64_t end = offset + buffer_used;
+    if (buffer_used > 0)
+    {
+        // the last block is written whole and cut off below
+        const size_t size = (buffer_used + block_size - 1) / block_size * block_size;
+        std::memset(buffer + buffer_used, 0, size - buffer_used);
+        flush_buffer(size);
+    }
+    if (ftruncate(fd, (off_t)end) != 0)
+    {
+        throw std::runtime_error("ftruncate: " + path + ": " + std::strerror(errno));
+    }
+    write_header(true);
+    ::close(fd);
+    fd = -1;
+}
+
+uint64_t WavFile::data_size() const
+{
+    return samples_size;
+}
+
+void WavFile::flush_buffer(size_t size)
+{
+    if (config.preallocate_size > 0 && offset + size > allocated)
+    {
+        const uint64_t length = std::max<uint64_t>(config.preallocate_size, offset + size - allocated);
+        // KEEP_SIZE: a file cut short by a crash ends at its last sample
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t)allocated, (off_t)length) == 0)
+        {
+            allocated += length;
+        }
+        else
+        {
+            config.preallocate_size = 0;
+        }
+    }
+    write_at(buffer, size, offset);
+    offset += size;
+    buffer_used = 0;
+}
+
+void WavFile::write_header(bool known)
+{
+    const uint32_t data_chunk_size = known ? (uint32_t)samples_size : 0xffffffff;
+    const uint32_t riff_chunk_size = known ? (uint32_t)(block_size - 8 + samples_size + (samples_size & 1)) : 0xffffffff;
+
+    std::memset(header, 0, block_size);
+    uint8_t *p = header;
+    std::memcpy(p, "RIFF", 4);
+    put_le32(p + 4, riff_chunk_size);
+    std::memcpy(p + 8, "WAVE", 4);
+    p += riff_size;
+
+    std::memcpy(p, "fmt ", 4);
+    put_le32(p + 4, 18);
+    put_le16(p + 8, sample_format);
+    put_le16(p + 10, 1);
+    put_le32(p + 12, rate);
+    put_le32(p + 16, rate);
+    put_le16(p + 20, 1);
+    put_le16(p + 22, 8);
+    put_le16(p + 24, 0);
+    p += fmt_size;
+
+    // sample count, required for non-PCM formats
+    std::memcpy(p, "fact", 4);
+    put_le32(p + 4, 4);
+    put_le32(p + 8, known ? (uint32_t)samples_size : 0);
+    p += fact_size;
+
+    std::memcpy(p, "JUNK", 4);
+    put_le32(p + 4, (uint32_t)(junk_size - 8));
+    p += junk_size;
+
+    std::memcpy(p, "data", 4);
+    put_le32(p + 4, data_chunk_size);
+
+    write_at(header, block_size, 0);
+}
+
+void WavFile::write_at(const uint8_t *data, size_t size, uint64_t at)
+{
+    while (size > 0)
+    {
+        const ssize_t n = pwrite(fd, data, size, (off_t)at);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error("pwrite: " + path + ": " + (n < 0 ? std::strerror(errno) : "no space"));
+        }
+        data += n;
+        size -= (size_t)n;
+        at += (uint64_t)n;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef INCLUDE_GUARD_WAV_FILE_HPP
+#define INCLUDE_GUARD_WAV_FILE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// writes a mono RIFF/WAVE file of 8 bit G.711 samples.
+// the header fills the first block_size bytes, padded with a JUNK chunk,
+// so the samples start block aligned. samples are collected in a block
+// aligned buffer and written as whole blocks at block aligned offsets,
+// which is what O_DIRECT requires, and disk space is reserved ahead with
+// fallocate. close() writes the last partial block, trims the file and
+// rewrites the header with the final sizes. until then the header has
+// 0xffffffff sizes, the "unknown length" of streamed WAV files.
+class WavFile
+{
+public:
+    static const size_t block_size = 4096;
+
+    enum format : uint16_t
+    {
+        ALAW = 6,
+        MULAW = 7,
+    };
+
+    typedef struct Config
+    {
+        // rounded up to block_size
+        size_t buffer_size = 32 * 1024;
+        // reserved at once when the file grows, 0 disables
+        size_t preallocate_size = 1024 * 1024;
+        // open with O_DIRECT, falls back to the page cache where the file
+        // system does not support it
+        bool direct = false;
+    } config_t;
+
+    // throws std::runtime_error if the file cannot be created, also if it
+    // exists already
+    WavFile(const std::string &path, format f, uint32_t sample_rate, const config_t &c);
+    // closes without finishing, the file keeps the header of an unknown length
+    ~WavFile();
+    WavFile(WavFile const &) = delete;
+    WavFile &operator=(WavFile const &) = delete;
+
+    // write() and fill() throw std::runtime_error if a block cannot be written
+    void write(const uint8_t *data, size_t size);
+    // `count` samples of `value`, e.g. silence
+    void fill(uint8_t value, size_t count);
+    void close();
+
+    // bytes of samples written so far
+    uint64_t data_size() const;
+
+private:
+    std::string path;
+    config_t config;
+    uint16_t sample_format;
+    uint32_t rate;
+    int fd;
+    uint8_t *buffer;
+    size_t buffer_used;
+    uint8_t *header;
+    // file offset of buffer[0]
+    uint64_t offset;
+    uint64_t allocated;
+    uint64_t samples_size;
+
+    void flush_buffer(size_t size);
+    // with the final sizes if `known`, else with unknown ones
+    void write_header(bool known);
+    void write_at(const uint8_t *data, size_t size, uint64_t at);
+};
+
+#endif // INCLUDE_GUARD_WAV_FILE_HPP
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <unistd.h>
+#include "safe-queue.hpp"
+#include "double-buffer-queue.hpp"
+
+// bursty RTP-like workload for the sniffer -> writer queues of Capture.
+// the producer pushes `burst` datagrams as fast as it can, then idles
+// until the next burst and flushes every `flush_interval_ms`, like the live
+// sniffer with --queue-flush-interval. the consumer mirrors the capture
+// writer loop: swap everything pending and serialize it, sleep 5 ms only if
+// nothing was pending.
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef struct Record
+{
+    std::string layer_2_type = "ETHERNET_II";
+    std::string layer_2_src_addr = "00:11:22:33:44:55";
+    std::string layer_2_dst_addr = "66:77:88:99:aa:bb";
+    std::string layer_3_type = "IP";
+    std::string layer_3_src_addr = "192.168.0.10";
+    std::string layer_3_dst_addr = "192.168.0.20";
+    std::string layer_4_type = "UDP";
+    std::string layer_4_src_port = "6000";
+    std::string layer_4_dst_port = "6002";
+    std::string payload_type = "UDP";
+    std::string payload_size = "172";
+    std::string payload_encoding_type = "base64";
+    std::string payload = std::string(232, 'A');
+    bench_clock::time_point enqueued;
+} record_t;
+
+typedef struct Result
+{
+    double producer_ns_per_push;
+    double elapsed_ms;
+    // printed, so the stand-in serialization is not optimized away
+    size_t serialized_bytes;
+    std::vector<int64_t> latency_us;
+} result_t;
+
+static result_t run(BatchQueue<record_t> &queue, int bursts, int burst, int burst_interval_ms, int flush_interval_ms)
+{
+    const size_t total = (size_t)bursts * burst;
+    result_t result;
+    result.latency_us.reserve(total);
+
+    std::thread consumer([&] {
+        std::vector<record_t> batch;
+        size_t received = 0;
+        size_t serialized = 0;
+        while (received < total)
+        {
+            batch.clear();
+            if (queue.size() > 0)
+            {
+                queue.swap(batch);
+                const auto now = bench_clock::now();
+                for (const auto &r : batch)
+                {
+                    // stand-in for the XADD serialization
+                    serialized += r.payload.size() + r.layer_3_src_addr.size();
+                    result.latency_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - r.enqueued).count());
+                }
+                received += batch.size();
+            }
+            if (batch.empty())
+            {
+                usleep(5000);
+            }
+        }
+        result.serialized_bytes = serialized;
+    });
+
+    bench_clock::duration push_time{0};
+    const auto start = bench_clock::now();
+    std::vector<record_t> records;
+    for (int b = 0; b < bursts; b++)
+    {
+        // build the records up front, so only the queue itself is timed
+        records.assign(burst, record_t());
+        const auto burst_start = bench_clock::now();
+        for (auto &r : records)
+        {
+            r.enqueued = bench_clock::now();
+            queue.push(std::move(r));
+        }
+        push_time += bench_clock::now() - burst_start;
+        const auto next_burst = burst_start + std::chrono::milliseconds(burst_interval_ms);
+        while (bench_clock::now() < next_burst)
+        {
+            std::this_thread::sleep_until(std::min(next_burst, bench_clock::now() + std::chrono::milliseconds(flush_interval_ms)));
+            queue.flush();
+        }
+    }
+    consumer.join();
+
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+    result.producer_ns_per_push = std::chrono::duration<double, std::nano>(push_time).count() / total;
+    std::sort(result.latency_us.begin(), result.latency_us.end());
+    return result;
+}
+
+static void report(const std::string &name, const result_t &r)
+{
+    auto pct = [&](double p) { return r.latency_us[std::min(r.latency_us.size() - 1, (size_t)(p * r.latency_us.size()))]; };
+    std::cout << std::left << std::setw(16) << name
+              << " push: " << std::fixed << std::setprecision(1) << std::setw(7) << r.producer_ns_per_push << " ns"
+              << "  latency p50: " << std::setw(6) << pct(0.50) << " us"
+              << "  p99: " << std::setw(6) << pct(0.99) << " us"
+              << "  max: " << r.latency_us.back() << " us"
+              << "  (" << r.serialized_bytes << " bytes)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const int bursts = argc > 1 ? std::stoi(argv[1]) : 20;
+    const int burst = argc > 2 ? std::stoi(argv[2]) : 50000;
+    const int burst_interval_ms = argc > 3 ? std::stoi(argv[3]) : 100;
+    const int publish_threshold = argc > 4 ? std::stoi(argv[4]) : 256;
+    const int flush_interval_ms = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    std::cout << bursts << " bursts of " << burst << " datagrams every " << burst_interval_ms << " ms" << std::endl;
+
+    {
+        SafeQueue<record_t> queue;
+        report("safe-queue", run(queue, bursts, burst, burst_interval_ms, flush_interval_ms));
+    }
+    {
+        DoubleBufferQueue<record_t> queue(publish_threshold);
+        report("double-buffer", run(queue, bursts, burst, burst_interval_ms, flush_interval_ms));
+    }
+
+    return 0;
+}
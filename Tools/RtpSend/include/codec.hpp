@@ -0,0 +1,246 @@
+#ifndef INCLUDE_GUARD_CODEC_HPP
+#define INCLUDE_GUARD_CODEC_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "g711.hpp"
+#include "riff.hpp"
+
+// converts WAV data to the payload of an RTP codec. the data is fed block by
+// block as Riff::WaveReader::stream() walks it, so only a block and the
+// resampler's last input samples are kept.
+namespace Codec
+{
+    typedef struct Codec
+    {
+        std::string name = "pcmu";
+        uint8_t payload_type = 0;
+        uint32_t clock_rate = 8000;
+        // bytes per sample in the payload
+        uint8_t sample_size = 1;
+    } codec_t;
+
+    inline bool supported(uint16_t format, uint16_t bits)
+    {
+        switch (format)
+        {
+        case Riff::WAVE_PCM:
+            return bits == 8 || bits == 16 || bits == 24 || bits == 32;
+        case Riff::WAVE_ALAW:
+        case Riff::WAVE_MULAW:
+            return bits == 8;
+        default:
+            return false;
+        }
+    }
+
+    // appends 16 bit mono samples of WAV data to `out`, channels are
+    // averaged. a trailing partial block is ignored.
+    inline void to_linear(uint16_t format, uint16_t channels, uint16_t bits, const uint8_t *data, size_t size,
+                          std::vector<int16_t> &out)
+    {
+        if (!supported(format, bits) || channels == 0)
+        {
+            throw std::runtime_error("unsupported wave format " + std::to_string(format) + ", " + std::to_string(bits) + " bits");
+        }
+        const size_t sample_size = bits / 8;
+        const size_t block_size = sample_size * channels;
+        const size_t count = size / block_size;
+        out.reserve(out.size() + count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint8_t *block = data + i * block_size;
+            int32_t sum = 0;
+            for (size_t c = 0; c < channels; c++)
+            {
+                const uint8_t *p = block + c * sample_size;
+                int16_t sample;
+                if (format == Riff::WAVE_ALAW)
+                {
+                    sample = G711::tables().alaw_linear[p[0]];
+                }
+                else if (format == Riff::WAVE_MULAW)
+                {
+                    sample = G711::tables().ulaw_linear[p[0]];
+                }
+                else if (sample_size == 1)
+                {
+                    // 8 bit PCM is unsigned
+                    sample = (int16_t)((p[0] - 128) << 8);
+                }
+                else
+                {
+                    // little endian, the top 16 bits are kept
+                    sample = (int16_t)(p[sample_size - 1] << 8 | p[sample_size - 2]);
+                }
+                sum += sample;
+            }
+            out.push_back((int16_t)(sum / (int32_t)channels));
+        }
+    }
+
+    // pcmu and pcma are 8000 Hz. l16 keeps `rate` and gets the static payload
+    // type 11 at 44100 Hz, 96 otherwise. a `payload_type` of 0..127 overrides.
+    inline codec_t select(const std::string &name, uint32_t rate, int payload_type = -1)
+    {
+        codec_t codec;
+        codec.name = name;
+        if (name == "pcmu")
+        {
+            codec.payload_type = 0;
+        }
+        else if (name == "pcma")
+        {
+            codec.payload_type = 8;
+        }
+        else if (name == "l16")
+        {
+            codec.payload_type = rate == 44100 ? 11 : 96;
+            codec.clock_rate = rate;
+            codec.sample_size = 2;
+        }
+        else
+        {
+            throw std::runtime_error("unknown codec: " + name);
+        }
+        if (payload_type >= 0 && payload_type <= 127)
+        {
+            codec.payload_type = (uint8_t)payload_type;
+        }
+        return codec;
+    }
+
+    // appends the payload bytes of `count` samples to `out`, l16 is big endian
+    inline void encode(const int16_t *samples, size_t count, const codec_t &codec, std::vector<uint8_t> &out)
+    {
+        const size_t offset = out.size();
+        out.resize(offset + count * codec.sample_size);
+        uint8_t *p = out.data() + offset;
+        if (codec.name == "pcmu")
+        {
+            G711::encode_ulaw(samples, count, p);
+        }
+        else if (codec.name == "pcma")
+        {
+            G711::encode_alaw(samples, count, p);
+        }
+        else
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                p[2 * i] = (uint8_t)((uint16_t)samples[i] >> 8);
+                p[2 * i + 1] = (uint8_t)samples[i];
+            }
+        }
+    }
+
+    // WAV data to codec payload in blocks of any size. mono G.711 data
+    // already in the codec is copied, since decoding and encoding again would
+    // not keep every code. resampling is linear interpolation without a low
+    // pass filter, good enough for test speech. downsampling wideband audio
+    // may alias above the new Nyquist.
+    class Transcoder
+    {
+    public:
+        Transcoder(uint16_t format, uint16_t channels, uint16_t bits, uint32_t rate, const codec_t &codec)
+            : format(format), channels(channels), bits(bits), from_rate(rate), codec(codec)
+        {
+            if (!supported(format, bits) || channels == 0 || rate == 0)
+            {
+                throw std::runtime_error("unsupported wave format " + std::to_string(format) + ", " + std::to_string(bits) + " bits");
+            }
+            const bool same_law = (format == Riff::WAVE_MULAW && codec.name == "pcmu") ||
+                                  (format == Riff::WAVE_ALAW && codec.name == "pcma");
+            copy = same_law && channels == 1 && rate == codec.clock_rate;
+            frame_size = (size_t)bits / 8 * channels;
+        }
+
+        // appends the payload of `size` bytes of WAV data to `out`. a partial
+        // sample frame at the end is kept for the next call.
+        void add(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+        {
+            if (copy)
+            {
+                out.insert(out.end(), data, data + size);
+                return;
+            }
+            if (!carry.empty())
+            {
+                const size_t take = std::min(size, frame_size - carry.size());
+                carry.insert(carry.end(), data, data + take);
+                data += take;
+                size -= take;
+                if (carry.size() == frame_size)
+                {
+                    to_linear(format, channels, bits, carry.data(), frame_size, linear);
+                    carry.clear();
+                }
+            }
+            const size_t whole = size / frame_size * frame_size;
+            to_linear(format, channels, bits, data, whole, linear);
+            carry.assign(data + whole, data + size);
+            in_count = linear_start + linear.size();
+            resample(false, out);
+        }
+
+        // appends the payload the last samples still produce
+        void finish(std::vector<uint8_t> &out)
+        {
+            if (!copy)
+            {
+                resample(true, out);
+            }
+        }
+
+    private:
+        const uint16_t format;
+        const uint16_t channels;
+        const uint16_t bits;
+        const uint32_t from_rate;
+        const codec_t codec;
+        bool copy;
+        size_t frame_size;
+        std::vector<uint8_t> carry;
+        // linear samples from input sample `linear_start` on
+        std::vector<int16_t> linear;
+        uint64_t linear_start = 0;
+        uint64_t in_count = 0;
+        uint64_t out_count = 0;
+        std::vector<int16_t> resampled;
+
+        // output sample i interpolates input samples i * from / to and the
+        // next one, which must have arrived unless `last` is set
+        void resample(bool last, std::vector<uint8_t> &out)
+        {
+            const uint32_t to_rate = codec.clock_rate;
+            const uint64_t out_total = in_count * to_rate / from_rate;
+            resampled.clear();
+            while (out_count < out_total)
+            {
+                const uint64_t position = out_count * from_rate;
+                const uint64_t index = position / to_rate;
+                if (index + 1 >= in_count && !last)
+                {
+                    break;
+                }
+                const uint64_t fraction = position % to_rate;
+                const int32_t a = linear[(size_t)(index - linear_start)];
+                const int32_t b = index + 1 < in_count ? linear[(size_t)(index + 1 - linear_start)] : a;
+                resampled.push_back((int16_t)(a + (int64_t)(b - a) * (int64_t)fraction / (int64_t)to_rate));
+                out_count++;
+            }
+            encode(resampled.data(), resampled.size(), codec, out);
+
+            // samples before the next output's source are not needed anymore
+            const uint64_t keep = std::min<uint64_t>(out_count * from_rate / to_rate, in_count);
+            linear.erase(linear.begin(), linear.begin() + (size_t)(keep - linear_start));
+            linear_start = keep;
+        }
+    };
+}
+
+#endif // INCLUDE_GUARD_CODEC_HPP
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_GUARD_FRAME_RING_HPP
+#define INCLUDE_GUARD_FRAME_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+// bounded single producer / single consumer ring of prebuilt packets. the
+// transcoding thread fills it ahead of the send loop, which only points its
+// iovecs at ready frames, so memory stays at `capacity` frames whatever the
+// length of the input. both sides poll, the producer is far ahead of the
+// payload time and the send loop only waits at the start and the end.
+class FrameRing
+{
+public:
+    FrameRing(size_t capacity, size_t stride)
+        : capacity(capacity), stride(stride), frames(capacity * stride), sizes(capacity) {}
+    FrameRing(const FrameRing &) = delete;
+    FrameRing &operator=(const FrameRing &) = delete;
+
+    // producer side. the frame to fill next, waits while the ring is full.
+    uint8_t *next_free()
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) >= capacity)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return &frames[(size_t)(t % capacity) * stride];
+    }
+
+    // hands the frame of next_free() with `size` bytes to the consumer
+    void produced(uint16_t size)
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        sizes[(size_t)(t % capacity)] = size;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    // no more frames will be produced
+    void finish()
+    {
+        finished.store(true, std::memory_order_release);
+    }
+
+    // consumer side. waits until `count` frames are ready or the producer
+    // finished, returns the number of ready frames.
+    size_t wait_ready(size_t count)
+    {
+        while (true)
+        {
+            const bool done = finished.load(std::memory_order_acquire);
+            const size_t ready = (size_t)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed));
+            if (ready >= count || done)
+            {
+                return ready;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // ready frame `i` after the oldest one, i < wait_ready()
+    uint8_t *frame(size_t i)
+    {
+        return &frames[(size_t)((head.load(std::memory_order_relaxed) + i) % capacity) * stride];
+    }
+
+    uint16_t frame_size(size_t i) const
+    {
+        return sizes[(size_t)((head.load(std::memory_order_relaxed) + i) % capacity)];
+    }
+
+    // the oldest `count` frames are sent and may be reused
+    void consumed(size_t count)
+    {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+private:
+    const size_t capacity;
+    const size_t stride;
+    std::vector<uint8_t> frames;
+    std::vector<uint16_t> sizes;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<bool> finished{false};
+};
+
+#endif // INCLUDE_GUARD_FRAME_RING_HPP
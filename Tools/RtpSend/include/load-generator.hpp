@@ -0,0 +1,79 @@
+#ifndef INCLUDE_GUARD_LOAD_GENERATOR_HPP
+#define INCLUDE_GUARD_LOAD_GENERATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+// simulates many concurrent RTP calls playing one encoded audio buffer.
+// calls are split over a few threads. every thread owns a timer wheel with
+// 1 ms ticks and sends the packets due in a tick, with sendmmsg on a raw
+// socket or one send per call on UDP sockets. call i uses ssrc + i and the
+// ports sport + 2i / dport + 2i.
+class LoadGenerator
+{
+public:
+    typedef struct Config
+    {
+        std::string interface = "";
+        // empty: the address the kernel routes towards destination from
+        std::string source = "";
+        std::string destination = "192.168.0.1";
+        uint16_t sport = 6000;
+        uint16_t dport = 6002;
+        uint32_t ssrc = 1234567890;
+        uint32_t calls = 1;
+        uint16_t payload_time_ms = 20;
+        uint8_t payload_type = 0;
+        uint32_t clock_rate = 8000;
+        // bytes per sample of `audio`
+        uint8_t sample_size = 1;
+        // call i starts i * ramp_ms / calls after the first one
+        uint32_t ramp_ms = 0;
+        // 0: every call plays the audio once, otherwise calls loop it
+        uint32_t duration_sec = 0;
+        uint32_t threads = 1;
+        // packets per sendmmsg call
+        uint32_t batch_size = 64;
+        uint32_t stats_interval_sec = 10;
+        uint32_t spin_us = 0;
+        // raw: one raw socket per thread and sendmmsg batches.
+        // udp: one connected UDP socket per call, the kernel builds IP/UDP.
+        std::string send_mode = "raw";
+    } config_t;
+
+    // `audio` is the encoded payload of a whole call, see Codec::Transcoder.
+    // it must outlive the generator.
+    LoadGenerator(const config_t &config, const std::vector<uint8_t> &audio);
+
+    // blocks until every call has ended
+    void run();
+
+private:
+    typedef struct Call
+    {
+        uint32_t ssrc = 0;
+        uint16_t sport = 0;
+        uint16_t dport = 0;
+        uint16_t sequence = 1;
+        uint32_t timestamp = 0;
+        size_t position = 0;
+        uint64_t next_tick = 0;
+        uint64_t end_tick = 0;
+        // udp mode only
+        int fd = -1;
+    } call_t;
+
+    config_t config;
+    const std::vector<uint8_t> &audio;
+    size_t payload_bytes;
+    in_addr source_addr;
+    in_addr destination_addr;
+    // udp mode, indexed by call
+    std::vector<int> call_fds;
+
+    void worker(int index, int fd, int64_t start_ns);
+};
+
+#endif // INCLUDE_GUARD_LOAD_GENERATOR_HPP
@@ -0,0 +1,34 @@
+#ifndef INCLUDE_GUARD_PACING_HPP
+#define INCLUDE_GUARD_PACING_HPP
+
+#include <cstdint>
+#include <cerrno>
+#include <time.h>
+
+inline int64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// sleeps until the absolute CLOCK_MONOTONIC time `deadline_ns`. the last
+// `spin_ns` are busy waited, to avoid the wakeup latency of the scheduler.
+inline void sleep_until(int64_t deadline_ns, int64_t spin_ns)
+{
+    const int64_t wake_ns = deadline_ns - spin_ns;
+    if (monotonic_ns() < wake_ns)
+    {
+        struct timespec ts;
+        ts.tv_sec = wake_ns / 1000000000;
+        ts.tv_nsec = wake_ns % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        {
+        }
+    }
+    while (spin_ns > 0 && monotonic_ns() < deadline_ns)
+    {
+    }
+}
+
+#endif // INCLUDE_GUARD_PACING_HPP
@@ -0,0 +1,219 @@
+#ifndef INCLUDE_GUARD_RTP_PACKET_HPP
+#define INCLUDE_GUARD_RTP_PACKET_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <string>
+#include <stdexcept>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+
+// IPv4 / UDP / RTP headers for raw sockets, and the raw and UDP socket setup.
+namespace RtpPacket
+{
+    const size_t ip_header_size = 20;
+    const size_t udp_header_size = 8;
+    const size_t rtp_header_size = 12;
+    const size_t header_size = ip_header_size + udp_header_size + rtp_header_size;
+
+    inline void put_be16(uint8_t *p, uint16_t v)
+    {
+        p[0] = (uint8_t)(v >> 8);
+        p[1] = (uint8_t)v;
+    }
+
+    inline void put_be32(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)(v >> 24);
+        p[1] = (uint8_t)(v >> 16);
+        p[2] = (uint8_t)(v >> 8);
+        p[3] = (uint8_t)v;
+    }
+
+    // one's complement sum of big endian 16 bit words, an odd byte is padded
+    inline uint32_t checksum_add(uint32_t sum, const uint8_t *p, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 1 < size; i += 2)
+        {
+            sum += (uint32_t)p[i] << 8 | p[i + 1];
+        }
+        if (i < size)
+        {
+            sum += (uint32_t)p[i] << 8;
+        }
+        return sum;
+    }
+
+    inline uint16_t checksum_fold(uint32_t sum)
+    {
+        while (sum >> 16)
+        {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        const uint16_t checksum = (uint16_t)~sum;
+        // 0 means "no checksum" in UDP
+        return checksum == 0 ? 0xffff : checksum;
+    }
+
+    // version 2, no marker
+    inline void write_rtp_header(uint8_t *h, uint8_t payload_type, uint16_t sequence, uint32_t timestamp, uint32_t ssrc)
+    {
+        h[0] = 0x80;
+        h[1] = payload_type & 0x7f;
+        put_be16(h + 2, sequence);
+        put_be32(h + 4, timestamp);
+        put_be32(h + 8, ssrc);
+    }
+
+    // writes the header_size bytes at `h`. the payload may live elsewhere,
+    // it is only read for the UDP checksum. the kernel fills in the IP id and
+    // header checksum.
+    inline void write_headers(uint8_t *h, const in_addr &source, const in_addr &destination,
+                              uint16_t sport, uint16_t dport, uint8_t payload_type,
+                              uint16_t sequence, uint32_t timestamp, uint32_t ssrc,
+                              const uint8_t *payload, size_t size)
+    {
+        const uint16_t udp_length = (uint16_t)(udp_header_size + rtp_header_size + size);
+
+        // ip
+        h[0] = 0x45;
+        h[1] = 0;
+        put_be16(h + 2, (uint16_t)(ip_header_size + udp_length));
+        put_be16(h + 4, 0);
+        put_be16(h + 6, 0);
+        h[8] = 128;
+        h[9] = IPPROTO_UDP;
+        put_be16(h + 10, 0);
+        std::memcpy(h + 12, &source, 4);
+        std::memcpy(h + 16, &destination, 4);
+
+        // udp
+        put_be16(h + 20, sport);
+        put_be16(h + 22, dport);
+        put_be16(h + 24, udp_length);
+        put_be16(h + 26, 0);
+
+        write_rtp_header(h + ip_header_size + udp_header_size, payload_type, sequence, timestamp, ssrc);
+
+        // pseudo header, udp header, rtp header, payload
+        uint32_t sum = checksum_add(0, h + 12, 8);
+        sum += IPPROTO_UDP + udp_length;
+        sum = checksum_add(sum, h + 20, udp_header_size + rtp_header_size);
+        sum = checksum_add(sum, payload, size);
+        put_be16(h + 26, checksum_fold(sum));
+    }
+
+    inline in_addr parse_address(const std::string &address)
+    {
+        in_addr addr;
+        if (inet_pton(AF_INET, address.c_str(), &addr) != 1)
+        {
+            throw std::runtime_error("invalid address: " + address);
+        }
+        return addr;
+    }
+
+    // the local address the kernel routes towards `destination` from.
+    // a connected UDP socket reports it without sending anything.
+    inline in_addr route_source(const in_addr &destination, uint16_t port)
+    {
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr = destination;
+        socklen_t length = sizeof(addr);
+        if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || getsockname(fd, (sockaddr *)&addr, &length) != 0)
+        {
+            const std::string error = strerror(errno);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            throw std::runtime_error("no route: " + error);
+        }
+        close(fd);
+        return addr.sin_addr;
+    }
+
+    // IPPROTO_RAW implies IP_HDRINCL, so packets carry their own headers.
+    // `interface` may be empty to send by the routing table.
+    inline int open_raw_socket(const std::string &interface)
+    {
+        const int fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("raw socket: ") + strerror(errno));
+        }
+        if (!interface.empty() &&
+            setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(), interface.size()) != 0)
+        {
+            const std::string error = strerror(errno);
+            close(fd);
+            throw std::runtime_error("bind to " + interface + ": " + error);
+        }
+        // room for a few ticks of packets, the kernel caps it at wmem_max
+        const int buffer_size = 4 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+        return fd;
+    }
+
+    // a UDP socket bound to source:sport and connected to destination:dport.
+    // the kernel builds the IP and UDP headers, so only the RTP part is sent.
+    inline int open_udp_socket(const std::string &interface, const in_addr &source, uint16_t sport,
+                               const in_addr &destination, uint16_t dport)
+    {
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("udp socket: ") + strerror(errno));
+        }
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr = source;
+        addr.sin_port = htons(sport);
+        std::string step = "bind to " + interface;
+        bool ok = interface.empty() || setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, interface.c_str(), interface.size()) == 0;
+        if (ok)
+        {
+            step = "bind to port " + std::to_string(sport);
+            ok = bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+        }
+        if (ok)
+        {
+            step = "connect";
+            addr.sin_addr = destination;
+            addr.sin_port = htons(dport);
+            ok = connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0;
+        }
+        if (!ok)
+        {
+            const std::string error = strerror(errno);
+            close(fd);
+            throw std::runtime_error(step + ": " + error);
+        }
+        return fd;
+    }
+
+    // SO_TXTIME: every packet carries its transmit time in a SCM_TXTIME
+    // control message, and the fq or etf qdisc holds it until then.
+    // etf expects CLOCK_TAI, fq CLOCK_MONOTONIC.
+    inline void enable_txtime(int fd, clockid_t clock)
+    {
+        sock_txtime config = {};
+        config.clockid = clock;
+        config.flags = 0;
+        if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) != 0)
+        {
+            throw std::runtime_error(std::string("SO_TXTIME: ") + strerror(errno));
+        }
+    }
+}
+
+#endif // INCLUDE_GUARD_RTP_PACKET_HPP
@@ -0,0 +1,302 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include "load-generator.hpp"
+#include "histogram.hpp"
+#include "pacing.hpp"
+#include "rtp-packet.hpp"
+
+namespace
+{
+    using RtpPacket::header_size;
+
+    // power of two above any payload time, so most calls are due in the
+    // first round of their slot
+    const size_t wheel_size = 1024;
+
+    std::mutex output_mutex;
+
+    void print_line(const std::string &line)
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << line << std::endl;
+    }
+}
+
+LoadGenerator::LoadGenerator(const config_t &config, const std::vector<uint8_t> &audio)
+    : config(config), audio(audio)
+{
+    if (audio.empty())
+    {
+        throw std::runtime_error("no audio");
+    }
+    if (this->config.calls == 0)
+    {
+        throw std::runtime_error("calls must be at least 1");
+    }
+    if ((uint32_t)config.sport + 2 * (config.calls - 1) > 65535 || (uint32_t)config.dport + 2 * (config.calls - 1) > 65535)
+    {
+        throw std::runtime_error("ports of the last call exceed 65535");
+    }
+    this->config.threads = std::max<uint32_t>(1, std::min(config.threads, config.calls));
+    this->config.batch_size = std::max<uint32_t>(1, config.batch_size);
+    payload_bytes = (size_t)config.clock_rate * config.payload_time_ms / 1000 * config.sample_size;
+    if (payload_bytes == 0)
+    {
+        throw std::runtime_error("payload time too short for the clock rate");
+    }
+
+    destination_addr = RtpPacket::parse_address(config.destination);
+    source_addr = config.source.empty() ? RtpPacket::route_source(destination_addr, config.dport) : RtpPacket::parse_address(config.source);
+}
+
+void LoadGenerator::run()
+{
+    const bool udp = config.send_mode == "udp";
+    std::vector<int> fds;
+    try
+    {
+        if (udp)
+        {
+            // a socket per call, a few thousand calls exceed the default soft limit
+            rlimit limit;
+            if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+            {
+                limit.rlim_cur = limit.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &limit);
+            }
+            for (uint32_t i = 0; i < config.calls; i++)
+            {
+                call_fds.push_back(RtpPacket::open_udp_socket(config.interface,
+                                                              source_addr, (uint16_t)(config.sport + 2 * i),
+                                                              destination_addr, (uint16_t)(config.dport + 2 * i)));
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < config.threads; i++)
+            {
+                fds.push_back(RtpPacket::open_raw_socket(config.interface));
+            }
+        }
+    }
+    catch (std::runtime_error &)
+    {
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+        for (int fd : call_fds)
+        {
+            close(fd);
+        }
+        call_fds.clear();
+        throw;
+    }
+
+    // threads share the tick clock, so the ramp is the same as with one thread
+    const int64_t start_ns = monotonic_ns() + 10000000;
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < config.threads; i++)
+    {
+        threads.emplace_back(&LoadGenerator::worker, this, (int)i, udp ? -1 : fds[i], start_ns);
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    for (int fd : fds)
+    {
+        close(fd);
+    }
+    for (int fd : call_fds)
+    {
+        close(fd);
+    }
+    call_fds.clear();
+}
+
+void LoadGenerator::worker(int index, int fd, int64_t start_ns)
+{
+    const uint64_t period = config.payload_time_ms;
+    const int64_t spin_ns = (int64_t)config.spin_us * 1000;
+    const int64_t stats_interval_ns = (int64_t)config.stats_interval_sec * 1000000000;
+
+    // calls i, i + threads, ... belong to this worker
+    std::vector<call_t> calls;
+    std::vector<std::vector<uint32_t>> wheel(wheel_size);
+    for (uint32_t i = index; i < config.calls; i += config.threads)
+    {
+        call_t call;
+        call.ssrc = config.ssrc + i;
+        call.sport = (uint16_t)(config.sport + 2 * i);
+        call.dport = (uint16_t)(config.dport + 2 * i);
+        call.next_tick = (uint64_t)i * config.ramp_ms / config.calls;
+        call.end_tick = config.duration_sec > 0 ? call.next_tick + (uint64_t)config.duration_sec * 1000 : UINT64_MAX;
+        call.fd = call_fds.empty() ? -1 : call_fds[i];
+        wheel[call.next_tick % wheel_size].push_back((uint32_t)calls.size());
+        calls.push_back(call);
+    }
+    size_t active = calls.size();
+
+    // message k sends headers[k] and a slice of `audio`
+    sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_addr = destination_addr;
+    std::vector<uint8_t> headers(config.batch_size * header_size);
+    std::vector<iovec> iovecs(config.batch_size * 2);
+    std::vector<mmsghdr> messages(config.batch_size);
+    for (size_t k = 0; k < config.batch_size; k++)
+    {
+        iovecs[2 * k].iov_base = &headers[k * header_size];
+        iovecs[2 * k].iov_len = header_size;
+        messages[k] = {};
+        messages[k].msg_hdr.msg_name = &destination;
+        messages[k].msg_hdr.msg_namelen = sizeof(destination);
+        messages[k].msg_hdr.msg_iov = &iovecs[2 * k];
+        messages[k].msg_hdr.msg_iovlen = 2;
+    }
+    size_t pending = 0;
+
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    uint64_t interval_sent = 0;
+    Histogram tick_lateness_us;
+
+    auto flush = [&] {
+        size_t done = 0;
+        while (done < pending)
+        {
+            const int n = sendmmsg(fd, &messages[done], pending - done, 0);
+            if (n > 0)
+            {
+                done += n;
+                sent += n;
+                interval_sent += n;
+            }
+            else if (errno != EINTR)
+            {
+                // skip the message that failed, e.g. ENOBUFS
+                done++;
+                dropped++;
+            }
+        }
+        pending = 0;
+    };
+
+    auto append = [&](call_t &call) {
+        const size_t size = std::min(payload_bytes, audio.size() - call.position);
+        const uint8_t *payload = audio.data() + call.position;
+        if (call.fd >= 0)
+        {
+            // udp mode, the rtp header is the only header to write
+            uint8_t *h = &headers[0];
+            RtpPacket::write_rtp_header(h, config.payload_type, call.sequence, call.timestamp, call.ssrc);
+            iovec iov[2] = {{h, RtpPacket::rtp_header_size}, {(void *)payload, size}};
+            // an ICMP port unreachable fails the next send once
+            ssize_t result = writev(call.fd, iov, 2);
+            if (result < 0 && errno == ECONNREFUSED)
+            {
+                result = writev(call.fd, iov, 2);
+            }
+            if (result < 0)
+            {
+                dropped++;
+            }
+            else
+            {
+                sent++;
+                interval_sent++;
+            }
+        }
+        else
+        {
+            RtpPacket::write_headers(&headers[pending * header_size], source_addr, destination_addr,
+                                     call.sport, call.dport, config.payload_type, call.sequence, call.timestamp, call.ssrc,
+                                     payload, size);
+            iovecs[2 * pending + 1].iov_base = (void *)payload;
+            iovecs[2 * pending + 1].iov_len = size;
+            pending++;
+            if (pending == config.batch_size)
+            {
+                flush();
+            }
+        }
+
+        call.sequence++;
+        call.timestamp += (uint32_t)(size / config.sample_size);
+        call.position += size;
+        if (call.position >= audio.size())
+        {
+            if (config.duration_sec == 0)
+            {
+                return false;
+            }
+            call.position = 0;
+        }
+        call.next_tick += period;
+        return call.next_tick < call.end_tick;
+    };
+
+    std::vector<uint32_t> due;
+    int64_t next_stats_ns = start_ns + stats_interval_ns;
+    uint64_t tick = 0;
+    while (active > 0)
+    {
+        const int64_t deadline_ns = start_ns + (int64_t)tick * 1000000;
+        sleep_until(deadline_ns, spin_ns);
+        const int64_t now_ns = monotonic_ns();
+        tick_lateness_us.record((uint64_t)std::max<int64_t>(0, now_ns - deadline_ns) / 1000);
+
+        // calls of later rounds go back into the slot
+        std::vector<uint32_t> &slot = wheel[tick % wheel_size];
+        due.swap(slot);
+        slot.clear();
+        for (uint32_t id : due)
+        {
+            call_t &call = calls[id];
+            if (call.next_tick != tick)
+            {
+                slot.push_back(id);
+            }
+            else if (append(call))
+            {
+                wheel[call.next_tick % wheel_size].push_back(id);
+            }
+            else
+            {
+                active--;
+            }
+        }
+        flush();
+
+        if (stats_interval_ns > 0 && now_ns >= next_stats_ns)
+        {
+            std::ostringstream line;
+            line << "thread " << index << ": " << active << " calls, "
+                 << interval_sent / config.stats_interval_sec << " packets/s, "
+                 << dropped << " dropped, tick lateness [us] p50 " << tick_lateness_us.percentile(50)
+                 << " p99 " << tick_lateness_us.percentile(99)
+                 << " max " << tick_lateness_us.max();
+            print_line(line.str());
+            tick_lateness_us.reset();
+            interval_sent = 0;
+            next_stats_ns += stats_interval_ns;
+        }
+        tick++;
+    }
+
+    std::ostringstream line;
+    line << "thread " << index << ": " << calls.size() << " calls ended, "
+         << sent << " packets sent, " << dropped << " dropped";
+    print_line(line.str());
+}
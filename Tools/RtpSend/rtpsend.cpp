@@ -1,21 +1,37 @@
 #include <iostream>
 #include <iomanip>
-#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
 #include <stdio.h>
 #include <time.h>
-#include <sys/time.h>
+#include <sys/socket.h>
 #include "cmdline.h"
-#include <tins/tins.h>
+#include "histogram.hpp"
+#include "pacing.hpp"
+#include "load-generator.hpp"
+#include "rtp-packet.hpp"
+#include "codec.hpp"
+#include "riff.hpp"
+#include "frame-ring.hpp"
 #include <unistd.h>
 
-uint32_t char_to_uint32_le(char *c, int i)
+void print_stats(const std::string &label, const Histogram &lateness_us, const Histogram &interval_us)
 {
-    return (uint32_t)((uint8_t)c[i] | (uint8_t)c[i + 1] << 8 | (uint8_t)c[i + 2] << 16 | (uint8_t)c[i + 3] << 24);
-}
-
-uint16_t char_to_uint16_le(char *c, int i)
-{
-    return (uint16_t)((uint8_t)c[i] | (uint8_t)c[i + 1] << 8);
+    std::cout << label << ": " << lateness_us.count() << " sends"
+              << ", lateness [us] p50 " << lateness_us.percentile(50)
+              << " p99 " << lateness_us.percentile(99)
+              << " p99.9 " << lateness_us.percentile(99.9)
+              << " max " << lateness_us.max()
+              << ", interval jitter [us] p50 " << interval_us.percentile(50)
+              << " p99 " << interval_us.percentile(99)
+              << " p99.9 " << interval_us.percentile(99.9)
+              << " max " << interval_us.max() << std::endl;
 }
 
 int main(int argc, char *argv[])
@@ -27,243 +43,388 @@ int main(int argc, char *argv[])
     cmdline_parser.add<std::string>("destination", 'd', "destination ip", false, "192.168.0.1");
     cmdline_parser.add<int>("sport", '\0', "source port", false, 6000);
     cmdline_parser.add<int>("dport", '\0', "destination port", false, 6002);
-    cmdline_parser.add<long>("sleep-adjustment-us", '\0', "sleep adjustment time [us]", false, 0);
+    cmdline_parser.add<std::string>("codec", 'c', "payload codec, the wave file is transcoded to it. pcmu, pcma: 8000 Hz, l16: wave rate", false, "pcmu", cmdline::oneof<std::string>("pcmu", "pcma", "l16"));
+    cmdline_parser.add<int>("payload-type", '\0', "rtp payload type, -1 is the codec default (0, 8, 11 or 96)", false, -1, cmdline::range(-1, 127));
+    cmdline_parser.add<uint32_t>("ssrc", '\0', "ssrc, call i of --calls uses ssrc + i", false, 1234567890);
+    cmdline_parser.add<uint32_t>("calls", '\0', "concurrent calls, each with its own ssrc and port pair", false, 1, cmdline::range<uint32_t>(1, 1000000));
+    cmdline_parser.add<uint32_t>("call-ramp-ms", '\0', "calls: start the calls spread over [ms]", false, 1000);
+    cmdline_parser.add<uint32_t>("duration", '\0', "calls: loop the audio for [s], 0 plays it once", false, 0);
+    cmdline_parser.add<uint32_t>("threads", '\0', "calls: sender threads", false, 2, cmdline::range<uint32_t>(1, 256));
+    cmdline_parser.add<uint32_t>("send-batch", '\0', "packets per sendmmsg, with --calls in raw mode or with --txtime", false, 64, cmdline::range<uint32_t>(1, 1024));
+    cmdline_parser.add<std::string>("send-mode", '\0', "raw: build IP/UDP headers, allows any --source. udp: connected UDP sockets", false, "raw", cmdline::oneof<std::string>("raw", "udp"));
+    cmdline_parser.add<std::string>("source", '\0', "source ip, default is the address routed to the destination", false, "");
+    cmdline_parser.add("txtime", '\0', "hand packets to the kernel ahead of time with SO_TXTIME, needs the fq or etf qdisc");
+    cmdline_parser.add<int>("txtime-lead-us", '\0', "txtime: submit packets ahead of their transmit time [us]", false, 2000, cmdline::range(0, 1000000));
+    cmdline_parser.add<std::string>("txtime-clock", '\0', "txtime: clock of the transmit times, tai for etf, monotonic for fq", false, "monotonic", cmdline::oneof<std::string>("monotonic", "tai"));
+    cmdline_parser.add<int>("spin-us", '\0', "busy wait the last microseconds before each deadline", false, 0, cmdline::range(0, 20000));
+    cmdline_parser.add<int>("stats-interval", '\0', "print send timing percentiles every [s], 0 prints the total only", false, 10, cmdline::range(0, 3600));
     cmdline_parser.parse_check(argc, argv);
 
-    std::ifstream ifs(cmdline_parser.get<std::string>("input-wave-file"), std::ios::binary);
-    if (!ifs)
+    std::unique_ptr<Riff::WaveReader> wave;
+    try
     {
-        std::cout << "error" << std::endl;
-        return -1;
+        wave.reset(new Riff::WaveReader(cmdline_parser.get<std::string>("input-wave-file")));
     }
-
-    ifs.seekg(0, std::ios::end);
-    long long int size = ifs.tellg();
-    std::cout << "file size: " << size << std::endl;
-
-    if (size < 12)
+    catch (std::runtime_error &e)
     {
-        std::cout << "file too small." << std::endl;
-        ifs.close();
+        std::cout << "Error: " << e.what() << std::endl;
         return -1;
     }
+    std::cout << "file size: " << wave->size() << std::endl;
+    for (const Riff::chunk_t &chunk : wave->chunks())
+    {
+        std::cout << "chunk_name: " << chunk.id << " chunk_size: " << chunk.size << " bytes" << std::endl;
+    }
+    if (wave->truncated())
+    {
+        std::cout << "Warning: data chunk is cut off, " << wave->data_size() << " bytes are left" << std::endl;
+    }
 
-    char *buffer2 = new char(2);
-    char *buffer4 = new char(4);
-
-    // RIFF
-    ifs.seekg(0, std::ios::beg);
-    ifs.read(buffer4, 4);
-    const std::string riff_mark = buffer4;
+    std::cout << "-------------" << std::endl;
 
-    // RIFF Chunk size
-    ifs.seekg(4, std::ios::beg);
-    ifs.read(buffer4, 4);
-    const uint32_t riff_chunk_size = char_to_uint32_le(buffer4, 0);
+    const Riff::format_t &format = wave->format();
+    const uint16_t wave_format = format.format;
+    const uint16_t wave_channel = format.channels;
+    const uint32_t wave_rates = format.sample_rate;
+    const uint32_t wave_bps = format.byte_rate;
+    const uint16_t wave_block_size = format.block_align;
+    const uint16_t wave_bits = format.bits_per_sample;
 
-    // WAVE
-    ifs.seekg(8, std::ios::beg);
-    ifs.read(buffer4, 4);
-    const std::string wave_mark = buffer4;
+    std::cout << "wave_format: " << wave_format << std::endl;
+    std::cout << "wave_channel: " << wave_channel << std::endl;
+    std::cout << "wave_rates: " << wave_rates << std::endl;
+    std::cout << "wave_bps: " << wave_bps << std::endl;
+    std::cout << "wave_block_size: " << wave_block_size << std::endl;
+    std::cout << "wave_bits: " << wave_bits << std::endl;
 
-    if (riff_mark == "RIFF" && wave_mark == "WAVE")
+    if (Codec::supported(wave_format, wave_bits) && wave_channel > 0 && wave_rates > 0)
     {
-        uint32_t fmt_chunk_start_pos = 0;
-        uint32_t fmt_chunk_size = 0;
-
-        uint32_t data_chunk_start_pos = 0;
-        uint32_t data_chunk_size = 0;
-
-        uint16_t loop_guard = 0;
-        const uint16_t loop_guard_max = 16;
-        uint32_t peek = 12;
-        std::string chunk_name = "";
-        uint32_t chunk_size = 0;
-
-        while (size > peek && loop_guard < loop_guard_max)
+        Codec::codec_t codec;
+        try
+        {
+            codec = Codec::select(cmdline_parser.get<std::string>("codec"), wave_rates, cmdline_parser.get<int>("payload-type"));
+        }
+        catch (std::runtime_error &e)
         {
-            //std::cout << "peek: " << peek << std::endl;
+            std::cout << "Error: " << e.what() << std::endl;
+            return -1;
+        }
+        std::cout << "-------------" << std::endl;
+        std::cout << "codec: " << codec.name << ", payload type " << (int)codec.payload_type
+                  << ", " << codec.clock_rate << " Hz" << std::endl;
 
-            ifs.seekg(peek, std::ios::beg);
-            ifs.read(buffer4, 4);
-            chunk_name = buffer4;
-            ifs.seekg(peek + 4, std::ios::beg);
-            ifs.read(buffer4, 4);
-            chunk_size = char_to_uint32_le(buffer4, 0);
+        uint16_t payload_time_ms = cmdline_parser.get<uint16_t>("payload-time-ms");
+        const size_t payload_bytes = (size_t)codec.clock_rate * payload_time_ms / 1000 * codec.sample_size;
+        if (payload_bytes == 0)
+        {
+            std::cout << "Error: no audio to send." << std::endl;
+            return -1;
+        }
+        if (payload_bytes + RtpPacket::header_size > 1500 && cmdline_parser.get<std::string>("send-mode") == "raw")
+        {
+            std::cout << "Warning: " << payload_bytes + RtpPacket::header_size
+                      << " byte packets exceed a 1500 byte MTU, raw mode does not fragment" << std::endl;
+        }
 
-            std::cout << "chunk_name: " << chunk_name << " chunk_size: " << chunk_size << " bytes" << std::endl;
+        // the data chunk is transcoded in blocks of this size as
+        // WaveReader::stream() walks it
+        const size_t stream_block_size = 64 * 1024;
 
-            if (chunk_name == "fmt ")
+        if (cmdline_parser.get<uint32_t>("calls") > 1)
+        {
+            // every call loops the same audio, so its encoded payload is
+            // kept whole. the wave data itself is not.
+            std::vector<uint8_t> audio;
+            try
             {
-                fmt_chunk_start_pos = peek + 8;
-                fmt_chunk_size = chunk_size;
+                Codec::Transcoder transcoder(wave_format, wave_channel, wave_bits, wave_rates, codec);
+                wave->stream(stream_block_size, [&](const uint8_t *block, size_t size) {
+                    transcoder.add(block, size, audio);
+                });
+                transcoder.finish(audio);
             }
-            else if (chunk_name == "data")
+            catch (std::runtime_error &e)
             {
-                data_chunk_start_pos = peek + 8;
-                data_chunk_size = chunk_size;
+                std::cout << "Error: " << e.what() << std::endl;
+                return -1;
+            }
+            wave.reset();
+            if (audio.empty())
+            {
+                std::cout << "Error: no audio to send." << std::endl;
+                return -1;
             }
 
-            peek = peek + 8 + chunk_size;
-            loop_guard++;
-
-            //std::cout << "next-peek: " << peek << std::endl;
+            LoadGenerator::config_t config;
+            config.interface = cmdline_parser.get<std::string>("interface");
+            config.source = cmdline_parser.get<std::string>("source");
+            config.destination = cmdline_parser.get<std::string>("destination");
+            config.sport = (uint16_t)cmdline_parser.get<int>("sport");
+            config.dport = (uint16_t)cmdline_parser.get<int>("dport");
+            config.ssrc = cmdline_parser.get<uint32_t>("ssrc");
+            config.calls = cmdline_parser.get<uint32_t>("calls");
+            config.payload_time_ms = payload_time_ms;
+            config.payload_type = codec.payload_type;
+            config.clock_rate = codec.clock_rate;
+            config.sample_size = codec.sample_size;
+            config.ramp_ms = cmdline_parser.get<uint32_t>("call-ramp-ms");
+            config.duration_sec = cmdline_parser.get<uint32_t>("duration");
+            config.threads = cmdline_parser.get<uint32_t>("threads");
+            config.batch_size = cmdline_parser.get<uint32_t>("send-batch");
+            config.stats_interval_sec = cmdline_parser.get<int>("stats-interval");
+            config.spin_us = cmdline_parser.get<int>("spin-us");
+            config.send_mode = cmdline_parser.get<std::string>("send-mode");
+            if (cmdline_parser.exist("txtime"))
+            {
+                std::cout << "Error: --txtime is not supported with --calls" << std::endl;
+                return -1;
+            }
+            try
+            {
+                LoadGenerator generator(config, audio);
+                generator.run();
+            }
+            catch (std::runtime_error &e)
+            {
+                std::cout << "Error: " << e.what() << std::endl;
+                return -1;
+            }
+            return 0;
         }
 
-        if (loop_guard >= loop_guard_max)
+        // packets are built ahead of the send loop into a ring of ready to
+        // send frames, see below
+        const size_t stride = RtpPacket::header_size + payload_bytes;
+        // raw mode sends whole frames, udp mode only the RTP part of them
+        const bool udp = cmdline_parser.get<std::string>("send-mode") == "udp";
+        const size_t skip = udp ? RtpPacket::ip_header_size + RtpPacket::udp_header_size : 0;
+        const bool txtime = cmdline_parser.exist("txtime");
+        const clockid_t txtime_clock = cmdline_parser.get<std::string>("txtime-clock") == "tai" ? CLOCK_TAI : CLOCK_MONOTONIC;
+        sockaddr_in destination = {};
+        destination.sin_family = AF_INET;
+        in_addr source_addr;
+        in_addr destination_addr;
+        int fd = -1;
+        try
         {
-            std::cout << "Error: LOOP GUARD." << peek << std::endl;
-            return -1;
+            destination_addr = RtpPacket::parse_address(cmdline_parser.get<std::string>("destination"));
+            source_addr = cmdline_parser.get<std::string>("source").empty()
+                              ? RtpPacket::route_source(destination_addr, cmdline_parser.get<int>("dport"))
+                              : RtpPacket::parse_address(cmdline_parser.get<std::string>("source"));
+            destination.sin_addr = destination_addr;
+            if (udp)
+            {
+                fd = RtpPacket::open_udp_socket(cmdline_parser.get<std::string>("interface"),
+                                                source_addr, (uint16_t)cmdline_parser.get<int>("sport"),
+                                                destination_addr, (uint16_t)cmdline_parser.get<int>("dport"));
+            }
+            else
+            {
+                fd = RtpPacket::open_raw_socket(cmdline_parser.get<std::string>("interface"));
+            }
+            if (txtime)
+            {
+                RtpPacket::enable_txtime(fd, txtime_clock);
+            }
         }
-
-        if (fmt_chunk_start_pos == 0 || data_chunk_start_pos == 0)
+        catch (std::runtime_error &e)
         {
-            std::cout << "Error: chunk not found." << peek << std::endl;
+            std::cout << "Error: " << e.what() << std::endl;
+            if (fd >= 0)
+            {
+                close(fd);
+            }
             return -1;
         }
 
-        // fmt chunk parse
-        if (fmt_chunk_size < 16)
+        // without txtime every packet is submitted alone at its deadline.
+        // with txtime a batch is submitted `lead` before its first deadline
+        // and every packet carries its own transmit time.
+        const size_t batch_size = txtime ? cmdline_parser.get<uint32_t>("send-batch") : 1;
+
+        // a thread transcodes the data chunk through WaveReader::stream()
+        // into a bounded ring of prebuilt frames, packet n with sequence
+        // n + 1 and timestamp n * payload samples. the send loop neither
+        // touches the file nor allocates, and memory does not grow with it.
+        const size_t ring_frames = std::max<size_t>(256, 4 * batch_size);
+        FrameRing ring(ring_frames, stride);
+        std::string transcode_error;
+        std::thread transcoding([&] {
+            try
+            {
+                Codec::Transcoder transcoder(wave_format, wave_channel, wave_bits, wave_rates, codec);
+                const uint16_t sport = (uint16_t)cmdline_parser.get<int>("sport");
+                const uint16_t dport = (uint16_t)cmdline_parser.get<int>("dport");
+                const uint32_t ssrc = cmdline_parser.get<uint32_t>("ssrc");
+                std::vector<uint8_t> audio;
+                size_t n = 0;
+                // frames of the whole payloads in `audio`, and of the rest at the end
+                auto build = [&](bool last) {
+                    size_t offset = 0;
+                    while (audio.size() - offset >= payload_bytes || (last && offset < audio.size()))
+                    {
+                        const size_t size = std::min(payload_bytes, audio.size() - offset);
+                        uint8_t *frame = ring.next_free();
+                        std::memcpy(frame + RtpPacket::header_size, audio.data() + offset, size);
+                        RtpPacket::write_headers(frame, source_addr, destination_addr, sport, dport,
+                                                 codec.payload_type, (uint16_t)(n + 1), (uint32_t)(n * payload_bytes / codec.sample_size), ssrc,
+                                                 frame + RtpPacket::header_size, size);
+                        ring.produced((uint16_t)(RtpPacket::header_size + size));
+                        offset += size;
+                        n++;
+                    }
+                    audio.erase(audio.begin(), audio.begin() + offset);
+                };
+                wave->stream(stream_block_size, [&](const uint8_t *block, size_t size) {
+                    transcoder.add(block, size, audio);
+                    build(false);
+                });
+                transcoder.finish(audio);
+                build(true);
+            }
+            catch (std::runtime_error &e)
+            {
+                transcode_error = e.what();
+            }
+            ring.finish();
+        });
+
+        // sending starts with a full ring, or the whole input if it is shorter
+        if (ring.wait_ready(ring_frames) == 0)
         {
-            std::cout << "Error: fmt chunk error." << peek << std::endl;
+            transcoding.join();
+            std::cout << "Error: " << (transcode_error.empty() ? "no audio to send." : transcode_error) << std::endl;
+            close(fd);
             return -1;
         }
+        const int64_t lead_ns = txtime ? (int64_t)cmdline_parser.get<int>("txtime-lead-us") * 1000 : 0;
+        const size_t control_size = CMSG_SPACE(sizeof(uint64_t));
+        std::vector<mmsghdr> messages(batch_size);
+        std::vector<iovec> iovecs(batch_size);
+        std::vector<uint64_t> control(batch_size * control_size / sizeof(uint64_t) + 1);
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            messages[i] = {};
+            messages[i].msg_hdr.msg_name = udp ? nullptr : &destination;
+            messages[i].msg_hdr.msg_namelen = udp ? 0 : sizeof(destination);
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            if (txtime)
+            {
+                messages[i].msg_hdr.msg_control = (uint8_t *)control.data() + i * control_size;
+                messages[i].msg_hdr.msg_controllen = control_size;
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_TXTIME;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+            }
+        }
 
-        std::cout << "-------------" << std::endl;
-
-        // wave format
-        ifs.seekg(fmt_chunk_start_pos, std::ios::beg);
-        ifs.read(buffer2, 2);
-        const uint16_t wave_format = char_to_uint16_le(buffer2, 0);
-
-        // wave channel
-        ifs.seekg(fmt_chunk_start_pos + 2, std::ios::beg);
-        ifs.read(buffer2, 2);
-        const uint16_t wave_channel = char_to_uint16_le(buffer2, 0);
-
-        // wave sampling rates
-        ifs.seekg(fmt_chunk_start_pos + 4, std::ios::beg);
-        ifs.read(buffer4, 4);
-        const uint32_t wave_rates = char_to_uint32_le(buffer4, 0);
-
-        // wave bps
-        ifs.seekg(fmt_chunk_start_pos + 8, std::ios::beg);
-        ifs.read(buffer4, 4);
-        const uint32_t wave_bps = char_to_uint32_le(buffer4, 0);
-
-        // wave block size
-        ifs.seekg(fmt_chunk_start_pos + 12, std::ios::beg);
-        ifs.read(buffer2, 2);
-        const uint16_t wave_block_size = char_to_uint16_le(buffer2, 0);
-
-        // wave bits
-        ifs.seekg(fmt_chunk_start_pos + 14, std::ios::beg);
-        ifs.read(buffer2, 2);
-        const uint16_t wave_bits = char_to_uint16_le(buffer2, 0);
-
-        std::cout << "wave_format: " << wave_format << std::endl;
-        std::cout << "wave_channel: " << wave_channel << std::endl;
-        std::cout << "wave_rates: " << wave_rates << std::endl;
-        std::cout << "wave_bps: " << wave_bps << std::endl;
-        std::cout << "wave_block_size: " << wave_block_size << std::endl;
-        std::cout << "wave_bits: " << wave_bits << std::endl;
-
-        if (wave_format == 7 && wave_channel == 1 && wave_rates == 8000 &&
-            wave_bps == 8000 && wave_block_size == 1 && wave_bits == 8)
+        // a connected UDP socket reports an ICMP port unreachable with the next
+        // send, which then fails with ECONNREFUSED and is retried below.
+
+        // every packet has an absolute deadline, start + n * payload time,
+        // so oversleeping one packet does not delay the following ones
+        const int64_t period_ns = (int64_t)payload_time_ms * 1000000;
+        const int64_t spin_ns = (int64_t)cmdline_parser.get<int>("spin-us") * 1000;
+        const int stats_interval = cmdline_parser.get<int>("stats-interval");
+        const int64_t start_ns = monotonic_ns() + lead_ns;
+        int64_t prev_sent_ns = 0;
+        int64_t next_stats_ns = start_ns + (int64_t)stats_interval * 1000000000;
+        uint64_t send_errors = 0;
+
+        // transmit times of the tai clock are shifted by its offset to monotonic
+        int64_t txtime_offset_ns = 0;
+        if (txtime_clock == CLOCK_TAI)
         {
-            std::cout << "-------------" << std::endl;
-            std::cout << "8bit, 8000Hz, Mono, Mu-Law" << std::endl;
+            struct timespec tai;
+            clock_gettime(CLOCK_TAI, &tai);
+            txtime_offset_ns = (int64_t)tai.tv_sec * 1000000000 + tai.tv_nsec - monotonic_ns();
+        }
 
-            uint16_t payload_time_ms = cmdline_parser.get<uint16_t>("payload-time-ms");
-            uint16_t payload_bytes = 8000 / (1000 / payload_time_ms);
-            uint32_t cnt = 0;
-            uint16_t sequence = 1;
-            uint32_t timestamp = 0;
-            uint32_t ssrc = 1234567890;
-            Tins::PacketSender sender;
-            Tins::NetworkInterface iface(cmdline_parser.get<std::string>("interface"));
+        // lateness: submission after the deadline. interval: deviation of the
+        // time between two submissions from the payload time, without txtime.
+        Histogram lateness_us;
+        Histogram interval_us;
+        Histogram total_lateness_us;
+        Histogram total_interval_us;
 
-            struct timeval cur_time;
-            struct timeval prev_time
+        size_t n = 0;
+        while (true)
+        {
+            const size_t count = std::min(batch_size, ring.wait_ready(batch_size));
+            if (count == 0)
             {
-                0
-            };
-            struct tm *time_st;
-
-            long start_sec = 0;
-            long start_usec = 0;
-            long delay_sum = 0;
-
-            while (cnt < data_chunk_size)
+                break;
+            }
+            for (size_t i = 0; i < count; i++)
             {
-                gettimeofday(&cur_time, NULL);
-                start_sec = (long)(cur_time.tv_sec);
-                start_usec = (long)(cur_time.tv_usec);
-
-                uint16_t read_size = cnt + payload_bytes > data_chunk_size ? data_chunk_size - cnt : payload_bytes;
-                char data_buffer[read_size];
-                ifs.seekg(data_chunk_start_pos + cnt, std::ios::beg);
-                ifs.read(data_buffer, read_size);
-
-                cnt += read_size;
-
-                Tins::RawPDU::payload_type payload;
-                payload.reserve(1024);
-                payload = {
-                    0b10000000, // version(2) = 2, padding(1) = 0, extension(1) = 0, CSRC Count(4) = 0
-                    0b00000000, // Marker(1) = 0, Payload Type(7) = 0
-                };
-                payload.push_back((sequence >> 8) & 0xff);
-                payload.push_back(sequence & 0xff);
-
-                payload.push_back((timestamp >> 24) & 0xff);
-                payload.push_back((timestamp >> 16) & 0xff);
-                payload.push_back((timestamp >> 8) & 0xff);
-                payload.push_back(timestamp & 0xff);
-
-                payload.push_back((ssrc >> 24) & 0xff);
-                payload.push_back((ssrc >> 16) & 0xff);
-                payload.push_back((ssrc >> 8) & 0xff);
-                payload.push_back(ssrc & 0xff);
-
-                for (int i = 0; i < read_size; i++)
+                iovecs[i].iov_base = ring.frame(i) + skip;
+                iovecs[i].iov_len = ring.frame_size(i) - skip;
+                if (txtime)
                 {
-                    payload.push_back(data_buffer[i]);
+                    const uint64_t transmit_ns = start_ns + (int64_t)(n + i) * period_ns + txtime_offset_ns;
+                    std::memcpy(CMSG_DATA(CMSG_FIRSTHDR(&messages[i].msg_hdr)), &transmit_ns, sizeof(transmit_ns));
                 }
+            }
 
-                Tins::IP pkt = Tins::IP(cmdline_parser.get<std::string>("destination")) / Tins::UDP(cmdline_parser.get<int>("dport"), cmdline_parser.get<int>("sport")) / Tins::RawPDU(payload);
-                sender.send(pkt, iface);
-
-                gettimeofday(&cur_time, NULL);
-                time_st = localtime(&cur_time.tv_sec);
-                long process_time_usec = ((long)(cur_time.tv_sec) - start_sec) * 1000000 + ((long)(cur_time.tv_usec) - start_usec);
-                long measured_payload_interval_us = (prev_time.tv_sec == 0) ? (long)payload_time_ms * (long)1000 : ((long)(cur_time.tv_sec) - (long)(prev_time.tv_sec)) * 1000000 + ((long)(cur_time.tv_usec) - (long)(prev_time.tv_usec));
-                long send_delay_us = measured_payload_interval_us - (long)(payload_time_ms * 1000);
-                std::cout << std::setfill('0') << std::right << std::setw(2) << time_st->tm_hour;
-                std::cout << ":" << std::setfill('0') << std::right << std::setw(2) << time_st->tm_min;
-                std::cout << ":" << std::setfill('0') << std::right << std::setw(2) << time_st->tm_sec;
-                std::cout << "." << std::setfill('0') << std::right << std::setw(6) << cur_time.tv_usec;
-                std::cout << std::setfill(' ');
-                std::cout << " seq: " << std::right << std::setw(4) << sequence;
-                std::cout << ", size: " << std::right << std::setw(3) << read_size;
-                std::cout << ", delay: " << std::right << std::setw(4) << send_delay_us;
-                std::cout << ", delay total: " << delay_sum << std::endl;
-                delay_sum += send_delay_us;
-                prev_time = cur_time;
+            const int64_t submit_ns = start_ns + (int64_t)n * period_ns - lead_ns;
+            sleep_until(submit_ns, spin_ns);
+            const int64_t sent_ns = monotonic_ns();
+            size_t done = 0;
+            while (done < count)
+            {
+                const int sent = sendmmsg(fd, &messages[done], count - done, 0);
+                if (sent > 0)
+                {
+                    done += sent;
+                }
+                else if (errno != EINTR && errno != ECONNREFUSED)
+                {
+                    done++;
+                    send_errors++;
+                }
+            }
+            ring.consumed(count);
 
-                sequence++;
-                timestamp += read_size;
+            const uint64_t late = (uint64_t)std::max<int64_t>(0, sent_ns - submit_ns) / 1000;
+            lateness_us.record(late);
+            total_lateness_us.record(late);
+            if (prev_sent_ns != 0 && !txtime)
+            {
+                const uint64_t deviation = (uint64_t)std::abs(sent_ns - prev_sent_ns - period_ns) / 1000;
+                interval_us.record(deviation);
+                total_interval_us.record(deviation);
+            }
+            prev_sent_ns = sent_ns;
 
-                usleep(payload_time_ms * 1000 - process_time_usec + cmdline_parser.get<long>("sleep-adjustment-us"));
+            if (stats_interval > 0 && sent_ns >= next_stats_ns)
+            {
+                print_stats("last " + std::to_string(stats_interval) + "s", lateness_us, interval_us);
+                lateness_us.reset();
+                interval_us.reset();
+                next_stats_ns += (int64_t)stats_interval * 1000000000;
             }
+            n += count;
         }
-        else
+        close(fd);
+        transcoding.join();
+        if (!transcode_error.empty())
         {
-            std::cout << "-------------" << std::endl;
-            std::cout << "Error: invalid format." << std::endl;
-            std::cout << "Please use 8bit, 8000Hz, Mono, Mu-Law" << std::endl;
-            return -1;
+            std::cout << "Error: " << transcode_error << std::endl;
         }
+
+        std::cout << "-------------" << std::endl;
+        std::cout << "sent " << n - send_errors << " packets in "
+                  << (double)(monotonic_ns() - start_ns) / 1e9 << " s, " << send_errors << " send errors" << std::endl;
+        print_stats("total", total_lateness_us, total_interval_us);
+    }
+    else
+    {
+        std::cout << "-------------" << std::endl;
+        std::cout << "Error: invalid format." << std::endl;
+        std::cout << "Please use 8/16/24/32 bit PCM, A-law or Mu-Law" << std::endl;
+        return -1;
     }
 
     return 0;
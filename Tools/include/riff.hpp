@@ -0,0 +1,289 @@
+#ifndef INCLUDE_GUARD_RIFF_HPP
+#define INCLUDE_GUARD_RIFF_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// RIFF / WAVE reader for the tools. the file is mapped read only and the
+// chunk list is walked once with bounds checks, no header field is read
+// outside the file. the data chunk is not copied: data() points into the
+// mapping and pages are read on access, and stream() walks it in blocks
+// and drops the pages behind it, so files larger than RAM can be read.
+namespace Riff
+{
+    enum wave_format : uint16_t
+    {
+        WAVE_PCM = 1,
+        WAVE_FLOAT = 3,
+        WAVE_ALAW = 6,
+        WAVE_MULAW = 7,
+        WAVE_EXTENSIBLE = 0xfffe,
+    };
+
+    typedef struct Format
+    {
+        // for WAVE_FORMAT_EXTENSIBLE the sub format, e.g. WAVE_PCM
+        uint16_t format = 0;
+        uint16_t channels = 0;
+        uint32_t sample_rate = 0;
+        uint32_t byte_rate = 0;
+        uint16_t block_align = 0;
+        uint16_t bits_per_sample = 0;
+    } format_t;
+
+    typedef struct Chunk
+    {
+        char id[5] = {};
+        uint64_t offset = 0; // of the chunk body
+        uint64_t size = 0;   // as stored, may be clamped for the data chunk
+    } chunk_t;
+
+    inline uint16_t get_le16(const uint8_t *p)
+    {
+        return (uint16_t)(p[0] | p[1] << 8);
+    }
+
+    inline uint32_t get_le32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    class WaveReader
+    {
+    public:
+        // throws std::runtime_error if the file is not a WAVE file with a
+        // fmt and a data chunk
+        explicit WaveReader(const std::string &path)
+        {
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0)
+            {
+                const std::string error = strerror(errno);
+                release();
+                throw std::runtime_error(path + ": " + error);
+            }
+            file_size = (uint64_t)st.st_size;
+            if (file_size < 12)
+            {
+                release();
+                throw std::runtime_error(path + ": file too small");
+            }
+            void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                const std::string error = strerror(errno);
+                release();
+                throw std::runtime_error(path + ": mmap: " + error);
+            }
+            base = (const uint8_t *)mapped;
+            try
+            {
+                parse();
+            }
+            catch (std::runtime_error &e)
+            {
+                release();
+                throw std::runtime_error(path + ": " + e.what());
+            }
+        }
+
+        WaveReader(const WaveReader &) = delete;
+        WaveReader &operator=(const WaveReader &) = delete;
+
+        ~WaveReader()
+        {
+            release();
+        }
+
+        uint64_t size() const
+        {
+            return file_size;
+        }
+
+        const format_t &format() const
+        {
+            return fmt;
+        }
+
+        // every chunk in file order, including fmt and data
+        const std::vector<chunk_t> &chunks() const
+        {
+            return chunk_list;
+        }
+
+        // the data chunk, clamped to the file if it is truncated
+        const uint8_t *data() const
+        {
+            return base + data_chunk.offset;
+        }
+
+        uint64_t data_size() const
+        {
+            return data_chunk.size;
+        }
+
+        bool truncated() const
+        {
+            return data_truncated;
+        }
+
+        // copies up to `size` bytes from `offset` of the data chunk, returns
+        // the number of bytes copied
+        size_t read(uint64_t offset, uint8_t *out, size_t size) const
+        {
+            if (offset >= data_chunk.size)
+            {
+                return 0;
+            }
+            const size_t count = (size_t)std::min<uint64_t>(size, data_chunk.size - offset);
+            std::memcpy(out, data() + offset, count);
+            return count;
+        }
+
+        // calls `callback(const uint8_t *block, size_t size)` for the data
+        // chunk in blocks of `block_size` bytes, whole sample frames. pages
+        // behind the current block are dropped from the mapping.
+        template <typename Callback>
+        void stream(size_t block_size, Callback callback) const
+        {
+            const size_t frame = fmt.block_align > 0 ? fmt.block_align : 1;
+            block_size = std::max(frame, block_size / frame * frame);
+            const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+            madvise((void *)(base + data_chunk.offset / page * page), data_chunk.size, MADV_SEQUENTIAL);
+            uint64_t dropped = data_chunk.offset / page * page;
+            for (uint64_t offset = 0; offset < data_chunk.size; offset += block_size)
+            {
+                const size_t count = (size_t)std::min<uint64_t>(block_size, data_chunk.size - offset);
+                callback(data() + offset, count);
+                const uint64_t done = (data_chunk.offset + offset + count) / page * page;
+                if (done > dropped)
+                {
+                    madvise((void *)(base + dropped), done - dropped, MADV_DONTNEED);
+                    dropped = done;
+                }
+            }
+        }
+
+    private:
+        int fd = -1;
+        const uint8_t *base = nullptr;
+        uint64_t file_size = 0;
+        format_t fmt;
+        chunk_t data_chunk;
+        bool data_truncated = false;
+        std::vector<chunk_t> chunk_list;
+
+        void release()
+        {
+            if (base != nullptr)
+            {
+                munmap((void *)base, file_size);
+                base = nullptr;
+            }
+            if (fd >= 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        void parse()
+        {
+            if (std::memcmp(base, "RIFF", 4) != 0 || std::memcmp(base + 8, "WAVE", 4) != 0)
+            {
+                throw std::runtime_error("not a RIFF WAVE file");
+            }
+            // the RIFF size is wrong in files of crashed writers, so only the
+            // file size bounds the chunk walk
+            const uint64_t end = file_size;
+
+            bool have_fmt = false;
+            bool have_data = false;
+            uint64_t peek = 12;
+            while (peek + 8 <= end)
+            {
+                chunk_t chunk;
+                std::memcpy(chunk.id, base + peek, 4);
+                chunk.offset = peek + 8;
+                chunk.size = get_le32(base + peek + 4);
+                if (chunk.offset + chunk.size > end)
+                {
+                    if (std::memcmp(chunk.id, "data", 4) != 0)
+                    {
+                        // a cut off trailing chunk, e.g. LIST, does not matter
+                        if (have_fmt && have_data)
+                        {
+                            break;
+                        }
+                        throw std::runtime_error(std::string("chunk '") + chunk.id + "' exceeds the file");
+                    }
+                    chunk.size = end - chunk.offset;
+                    data_truncated = true;
+                }
+                chunk_list.push_back(chunk);
+
+                if (std::memcmp(chunk.id, "fmt ", 4) == 0 && !have_fmt)
+                {
+                    parse_format(base + chunk.offset, chunk.size);
+                    have_fmt = true;
+                }
+                else if (std::memcmp(chunk.id, "data", 4) == 0 && !have_data)
+                {
+                    data_chunk = chunk;
+                    have_data = true;
+                }
+                // chunks are padded to an even size
+                peek = chunk.offset + chunk.size + (chunk.size & 1);
+            }
+            if (!have_fmt)
+            {
+                throw std::runtime_error("no fmt chunk");
+            }
+            if (!have_data)
+            {
+                throw std::runtime_error("no data chunk");
+            }
+            if (fmt.block_align > 0)
+            {
+                data_chunk.size -= data_chunk.size % fmt.block_align;
+            }
+        }
+
+        void parse_format(const uint8_t *p, uint64_t size)
+        {
+            if (size < 16)
+            {
+                throw std::runtime_error("fmt chunk too small");
+            }
+            fmt.format = get_le16(p);
+            fmt.channels = get_le16(p + 2);
+            fmt.sample_rate = get_le32(p + 4);
+            fmt.byte_rate = get_le32(p + 8);
+            fmt.block_align = get_le16(p + 12);
+            fmt.bits_per_sample = get_le16(p + 14);
+            if (fmt.format == WAVE_EXTENSIBLE)
+            {
+                // cbSize, valid bits, channel mask, then the sub format GUID
+                // whose first two bytes are the format tag
+                if (size < 40)
+                {
+                    throw std::runtime_error("extensible fmt chunk too small");
+                }
+                fmt.format = get_le16(p + 24);
+            }
+        }
+    };
+}
+
+#endif // INCLUDE_GUARD_RIFF_HPP